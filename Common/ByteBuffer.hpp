@@ -1,11 +1,164 @@
 #pragma once
 
+#include "slice.hpp"
+
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+#if !defined(_WIN32)
+#include <cerrno>
+#include <climits>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 namespace glasssix {
+    enum class Endian {
+        Little,
+        Big,
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        Native = Big,
+#else
+        Native = Little,
+#endif
+    };
+
+    namespace detail {
+        template <size_t N>
+        struct uint_of_size;
+        template <>
+        struct uint_of_size<1> {
+            using type = uint8_t;
+        };
+        template <>
+        struct uint_of_size<2> {
+            using type = uint16_t;
+        };
+        template <>
+        struct uint_of_size<4> {
+            using type = uint32_t;
+        };
+        template <>
+        struct uint_of_size<8> {
+            using type = uint64_t;
+        };
+
+        inline uint8_t byteswap(uint8_t v) {
+            return v;
+        }
+        inline uint16_t byteswap(uint16_t v) {
+            return static_cast<uint16_t>(v << 8 | v >> 8);
+        }
+        inline uint32_t byteswap(uint32_t v) {
+#if defined(__GNUC__)
+            return __builtin_bswap32(v);
+#else
+            return (v << 24) | ((v << 8) & 0x00FF0000u) | ((v >> 8) & 0x0000FF00u) | (v >> 24);
+#endif
+        }
+        inline uint64_t byteswap(uint64_t v) {
+#if defined(__GNUC__)
+            return __builtin_bswap64(v);
+#else
+            return (static_cast<uint64_t>(byteswap(static_cast<uint32_t>(v))) << 32) | byteswap(static_cast<uint32_t>(v >> 32));
+#endif
+        }
+
+        // Stores v at p in byte order E; compiles to a plain (or byte-swapping) move.
+        template <Endian E, typename T>
+        inline void store(char* p, T v) {
+            using U = typename uint_of_size<sizeof(T)>::type;
+            U u;
+            std::memcpy(&u, &v, sizeof u);
+            if constexpr (E != Endian::Native) {
+                u = byteswap(u);
+            }
+            std::memcpy(p, &u, sizeof u);
+        }
+
+        template <Endian E, typename T>
+        inline T load(const char* p) {
+            using U = typename uint_of_size<sizeof(T)>::type;
+            U u;
+            std::memcpy(&u, p, sizeof u);
+            if constexpr (E != Endian::Native) {
+                u = byteswap(u);
+            }
+            T v;
+            std::memcpy(&v, &u, sizeof v);
+            return v;
+        }
+
+        // Element-wise conversion; a loop of independent swaps the compiler vectorizes.
+        template <Endian E, typename T>
+        inline void store_array(char* p, const T* values, size_t count) {
+            if constexpr (E == Endian::Native || sizeof(T) == 1) {
+                std::memcpy(p, values, count * sizeof(T));
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    store<E>(p + i * sizeof(T), values[i]);
+                }
+            }
+        }
+
+        template <Endian E, typename T>
+        inline void load_array(const char* p, T* values, size_t count) {
+            if constexpr (E == Endian::Native || sizeof(T) == 1) {
+                std::memcpy(values, p, count * sizeof(T));
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = load<E, T>(p + i * sizeof(T));
+                }
+            }
+        }
+
+        // LEB128; returns the end of the written bytes (at most 10).
+        inline char* store_varint(char* p, uint64_t v) {
+            while (v >= 0x80) {
+                *p++ = static_cast<char>(v | 0x80);
+                v >>= 7;
+            }
+            *p++ = static_cast<char>(v);
+            return p;
+        }
+
+        inline uint64_t zigzag_encode(int64_t v) {
+            return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+        }
+
+        inline int64_t zigzag_decode(uint64_t v) {
+            return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+        }
+
+        template <typename A, typename = void>
+        struct has_good_size : std::false_type {};
+
+        template <typename A>
+        struct has_good_size<A, std::void_t<decltype(std::declval<const A&>().good_size(size_t{}))>>
+            : std::true_type {};
+
+        // The size an allocator would really hand out for n bytes, if it tells.
+        template <typename A>
+        size_t alloc_good_size(const A& alloc, size_t n) {
+            if constexpr (has_good_size<A>::value) {
+                return alloc.good_size(n);
+            } else {
+                return n;
+            }
+        }
+    } // namespace detail
+
     /*!
      * \class ByteBuffer
      *
@@ -30,23 +183,116 @@ namespace glasssix {
      *
      * Contact: kangpeng@glasssix.com
      *
+     * Up to InlineCapacity bytes (prepend area included) are stored inside
+     * the object, so small messages never allocate. Larger storage is one
+     * reference-counted block of raw memory from Alloc (rebound to char):
+     * growing never zero-fills, and only the readable bytes are copied on
+     * reallocation. Pass an arena or pool allocator to take blocks from it.
+     *
+     * read_shared() hands out bytes as a SharedSlice that keeps the block
+     * alive, so a parsed message can give out sub-views without copying.
+     * While such slices exist the buffer never writes over bytes it has
+     * already handed out: it keeps appending behind them and moves to a new
+     * block when the space runs out.
+     *
      */
-    class ByteBuffer {
+    template <typename Alloc = std::allocator<char>>
+    class BasicByteBuffer {
     public:
-        static const size_t CheapPrepend = 8;
-        static const size_t InitialSize = 1024;
+        using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<char>;
+
+        static constexpr size_t CheapPrepend = 8;
+        static constexpr size_t InlineCapacity = 256;
+        static constexpr size_t InitialSize = 1024;
+        static constexpr size_t MaxVarintBytes = 10;
+
+        /*!
+         * Automatic release of memory left over from a past peak. Every time
+         * the buffer drains, the highest offset used since the last decision
+         * is noted; after `window` drains, if the capacity exceeds `ratio`
+         * times that peak, the storage is reallocated to twice the peak (at
+         * least min_capacity). Deciding on a window of messages instead of on
+         * each one keeps oscillating message sizes from causing a
+         * reallocation per message. window == 0 disables it.
+         *
+         * release_on_drain instead gives the heap block back to the allocator
+         * every time the buffer drains, so an idle buffer holds no memory
+         * beyond its inline storage. Meant for pooled allocators, where taking
+         * the block again for the next message is cheap.
+         *
+         * release_before_write does the same lazily: a drained buffer keeps
+         * its block until the next ensure_writable_bytes, reserve or read_fd,
+         * which give it back before writing. Pointers into the drained bytes
+         * therefore stay valid until the next write.
+         */
+        struct ShrinkPolicy {
+            size_t window{0};
+            size_t ratio{4};
+            size_t min_capacity{CheapPrepend + InitialSize};
+            bool release_on_drain{false};
+            bool release_before_write{false};
+        };
+
+        // The default size keeps the storage inline.
+        explicit BasicByteBuffer(
+            size_t size = InlineCapacity - CheapPrepend, const allocator_type& alloc = allocator_type())
+            : BasicByteBuffer(size, CheapPrepend, alloc) {}
 
-        explicit ByteBuffer(size_t size = InitialSize)
-            : buffer_(CheapPrepend + size), reader_index_{CheapPrepend}, writer_index_{CheapPrepend} {
+        BasicByteBuffer(size_t size, size_t prepend_size, const allocator_type& alloc = allocator_type())
+            : alloc_{alloc}, reader_index_{prepend_size}, writer_index_{prepend_size}, prepend_size_{prepend_size} {
+            allocate(prepend_size + size);
             assert(readable_bytes() == 0);
-            assert(writable_bytes() == size);
-            assert(prependable_bytes() == CheapPrepend);
+            assert(writable_bytes() >= size);
+            assert(prependable_bytes() == prepend_size);
+        }
+
+        BasicByteBuffer(const BasicByteBuffer& rhs)
+            : alloc_{std::allocator_traits<allocator_type>::select_on_container_copy_construction(rhs.alloc_)},
+              reader_index_{rhs.prepend_size_}, writer_index_{rhs.prepend_size_}, prepend_size_{rhs.prepend_size_},
+              policy_{rhs.policy_} {
+            allocate(prepend_size_ + rhs.readable_bytes());
+            append(rhs.peek(), rhs.readable_bytes());
+        }
+
+        // rhs is left empty, with inline storage.
+        BasicByteBuffer(BasicByteBuffer&& rhs) noexcept
+            : alloc_{std::move(rhs.alloc_)}, prepend_size_{rhs.prepend_size_}, policy_{rhs.policy_},
+              drains_{rhs.drains_}, peak_{rhs.peak_} {
+            steal(rhs);
+        }
+
+        BasicByteBuffer& operator=(const BasicByteBuffer& rhs) {
+            if (this != &rhs) {
+                *this = BasicByteBuffer(rhs);
+            }
+            return *this;
         }
 
-        void swap(ByteBuffer& rhs) {
-            buffer_.swap(rhs.buffer_);
-            std::swap(reader_index_, rhs.reader_index_);
-            std::swap(writer_index_, rhs.writer_index_);
+        BasicByteBuffer& operator=(BasicByteBuffer&& rhs) noexcept {
+            if (this != &rhs) {
+                deallocate();
+                alloc_ = std::move(rhs.alloc_);
+                prepend_size_ = rhs.prepend_size_;
+                policy_ = rhs.policy_;
+                drains_ = rhs.drains_;
+                peak_ = rhs.peak_;
+                steal(rhs);
+            }
+            return *this;
+        }
+
+        ~BasicByteBuffer() {
+            deallocate();
+        }
+
+        void swap(BasicByteBuffer& rhs) noexcept {
+            BasicByteBuffer tmp(std::move(rhs));
+            rhs = std::move(*this);
+            *this = std::move(tmp);
+        }
+
+        allocator_type get_allocator() const {
+            return alloc_;
         }
 
         size_t readable_bytes() const {
@@ -54,7 +300,7 @@ namespace glasssix {
         }
 
         size_t writable_bytes() const {
-            return buffer_.size() - writer_index_;
+            return capacity_ - writer_index_;
         }
 
         size_t prependable_bytes() const {
@@ -74,14 +320,35 @@ namespace glasssix {
             }
         }
 
-        template <typename Tv, std::enable_if_t<std::is_integral_v<Tv>>* = nullptr>
+        template <typename Tv, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
         void skip_val() {
             skip(sizeof(Tv));
         }
 
         void skip_all() {
-            reader_index_ = CheapPrepend;
-            writer_index_ = CheapPrepend;
+            if (policy_.release_on_drain) {
+                // Slices still referencing the block keep it alive on their own.
+                deallocate();
+                reader_index_ = writer_index_ = prepend_size_;
+                return;
+            }
+            if (policy_.window != 0) {
+                note_drain();
+            }
+            release_pending_ = policy_.release_before_write && block_ != nullptr;
+            if (shared()) {
+                // The bytes before writer_index_ may still be referenced by slices.
+                reader_index_ = writer_index_;
+                return;
+            }
+            reader_index_ = prepend_size_;
+            writer_index_ = prepend_size_;
+        }
+
+        // Moves the reader back over len bytes that were just read.
+        void unread(size_t len) {
+            assert(len <= prependable_bytes());
+            reader_index_ -= len;
         }
 
         std::string read_all_as_string() {
@@ -99,6 +366,41 @@ namespace glasssix {
             return std::string_view(peek(), readable_bytes());
         }
 
+        Slice to_slice() const {
+            return Slice(peek(), readable_bytes());
+        }
+
+        /*!
+         * Reads len bytes as a slice that shares the buffer's block instead of
+         * copying them; it stays valid whatever happens to the buffer later.
+         * Bytes held in inline storage are copied into a block of their own.
+         */
+        SharedSlice read_shared(size_t len) {
+            assert(len <= readable_bytes());
+            if (len == 0) {
+                return SharedSlice();
+            }
+            heap_block* block = block_;
+            const char* d = peek();
+            if (block != nullptr) {
+                block->retain();
+            } else {
+                block = make_block(alloc_, len);
+                d = std::copy(peek(), peek() + len, block_data(block)) - len;
+            }
+            skip(len);
+            return SharedSlice(block, d, len);
+        }
+
+        SharedSlice read_all_shared() {
+            return read_shared(readable_bytes());
+        }
+
+        // True while slices returned by read_shared() still reference the storage.
+        bool shared() const {
+            return block_ != nullptr && !block_->unique();
+        }
+
         void append(std::string_view str) {
             append(str.data(), str.size());
         }
@@ -114,6 +416,7 @@ namespace glasssix {
         }
 
         void ensure_writable_bytes(size_t len) {
+            release_if_drained();
             if (writable_bytes() < len) {
                 make_space(len);
             }
@@ -138,79 +441,656 @@ namespace glasssix {
             writer_index_ -= len;
         }
 
-        template <typename Tv, std::enable_if_t<std::is_integral_v<Tv>>* = nullptr>
+        // Integers and floating-point values, in byte order E (host order by default).
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
         void append_val(Tv x) {
-            append(&x, sizeof x);
+            ensure_writable_bytes(sizeof x);
+            detail::store<E>(begin_write(), x);
+            has_written(sizeof x);
         }
 
         // Require: buf->readableBytes() >= sizeof(Tv)
-        template <typename Tv, std::enable_if_t<std::is_integral_v<Tv>>* = nullptr>
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
         Tv peek_val() const {
             assert(readable_bytes() >= sizeof(Tv));
-            Tv x = 0;
-            ::memcpy(&x, peek(), sizeof x);
-            return x;
+            return detail::load<E, Tv>(peek());
         }
 
         // Require: buf->readableBytes() >= sizeof(Tv)
-        template <typename Tv, std::enable_if_t<std::is_integral_v<Tv>>* = nullptr>
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
         Tv read_val() {
-            Tv result = peek_val<Tv>();
-            skip_val<Tv>();
+            Tv result = peek_val<Tv, E>();
+            skip(sizeof(Tv));
             return result;
         }
 
-        template <typename Tv, std::enable_if_t<std::is_integral_v<Tv>>* = nullptr>
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
         void prepend_val(Tv x) {
-            prepend(&x, sizeof x);
+            assert(sizeof x <= prependable_bytes());
+            unshare();
+            reader_index_ -= sizeof x;
+            detail::store<E>(begin() + reader_index_, x);
+        }
+
+        // count values with a single capacity check, converted to byte order E.
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
+        void append_array(const Tv* values, size_t count) {
+            ensure_writable_bytes(count * sizeof(Tv));
+            detail::store_array<E>(begin_write(), values, count);
+            has_written(count * sizeof(Tv));
+        }
+
+        template <Endian E = Endian::Native, typename Container,
+            typename Tv = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(std::declval<const Container&>()))>>>
+        void append_array(const Container& values) {
+            append_array<Tv, E>(std::data(values), std::size(values));
+        }
+
+        // Require: buf->readableBytes() >= count * sizeof(Tv)
+        template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
+        void read_array(Tv* values, size_t count) {
+            assert(readable_bytes() >= count * sizeof(Tv));
+            detail::load_array<E>(peek(), values, count);
+            skip(count * sizeof(Tv));
+        }
+
+        // Unsigned LEB128.
+        void append_varint(uint64_t v) {
+            ensure_writable_bytes(MaxVarintBytes);
+            writer_index_ = static_cast<size_t>(detail::store_varint(begin_write(), v) - begin());
+        }
+
+        // Zigzag + LEB128, so small negative numbers stay short.
+        void append_varint_signed(int64_t v) {
+            append_varint(detail::zigzag_encode(v));
+        }
+
+        /*!
+         * Reads an unsigned LEB128 value. Nothing is consumed if the readable
+         * bytes hold no complete varint.
+         * \return false if truncated or longer than 10 bytes
+         */
+        bool read_varint(uint64_t& v) {
+            const size_t n = peek_varint(v);
+            if (n == 0) {
+                return false;
+            }
+            skip(n);
+            return true;
+        }
+
+        /*!
+         * Decodes an unsigned LEB128 value at the read position without
+         * consuming it.
+         * \return its size in bytes, 0 if truncated or longer than 10 bytes
+         */
+        size_t peek_varint(uint64_t& v) const {
+            const auto* p = reinterpret_cast<const unsigned char*>(peek());
+            const size_t n = std::min(readable_bytes(), MaxVarintBytes);
+            uint64_t result = 0;
+            for (size_t i = 0; i < n; ++i) {
+                result |= static_cast<uint64_t>(p[i] & 0x7F) << (7 * i);
+                if (!(p[i] & 0x80)) {
+                    v = result;
+                    return i + 1;
+                }
+            }
+            return 0;
+        }
+
+        bool read_varint_signed(int64_t& v) {
+            uint64_t u;
+            if (!read_varint(u)) {
+                return false;
+            }
+            v = detail::zigzag_decode(u);
+            return true;
+        }
+
+        // Varint length followed by the bytes.
+        void append_string(std::string_view str) {
+            ensure_writable_bytes(MaxVarintBytes + str.size());
+            char* p = detail::store_varint(begin_write(), str.size());
+            std::memcpy(p, str.data(), str.size());
+            writer_index_ = static_cast<size_t>(p - begin()) + str.size();
+        }
+
+        /*!
+         * Reads a string written by append_string. The view points into the
+         * buffer and is valid until the next modification. Nothing is consumed
+         * if the string is incomplete.
+         */
+        bool read_string(std::string_view& str) {
+            uint64_t len;
+            const size_t n = peek_varint(len);
+            if (n == 0 || len > readable_bytes() - n) {
+                return false;
+            }
+            str = std::string_view(peek() + n, static_cast<size_t>(len));
+            // Advanced directly: skip() could drain and reset or release the storage under str.
+            reader_index_ += n + static_cast<size_t>(len);
+            return true;
+        }
+
+        /*!
+         * \brief Reserve-once encoder over the writable space.
+         *
+         * Puts are unchecked stores (asserted in debug builds) into space
+         * reserved up front, so encoding a message is straight-line code.
+         * The bytes are committed to the buffer by finish() or the destructor.
+         *
+         * \code
+         * auto w = buf.writer(64);
+         * w.put<uint16_t, Endian::Big>(type).put_varint(id).put_string(name);
+         * \endcode
+         */
+        class Writer {
+        public:
+            Writer(BasicByteBuffer& buffer, size_t max_bytes) : buffer_{&buffer} {
+                buffer.ensure_writable_bytes(max_bytes);
+                begin_ = cur_ = buffer.begin_write();
+                end_ = cur_ + max_bytes;
+            }
+
+            ~Writer() {
+                finish();
+            }
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
+            Writer& put(Tv v) {
+                assert(cur_ + sizeof v <= end_);
+                detail::store<E>(cur_, v);
+                cur_ += sizeof v;
+                return *this;
+            }
+
+            template <typename Tv, Endian E = Endian::Native, std::enable_if_t<std::is_arithmetic_v<Tv>>* = nullptr>
+            Writer& put_array(const Tv* values, size_t count) {
+                assert(cur_ + count * sizeof(Tv) <= end_);
+                detail::store_array<E>(cur_, values, count);
+                cur_ += count * sizeof(Tv);
+                return *this;
+            }
+
+            Writer& put_bytes(const void* data, size_t len) {
+                assert(cur_ + len <= end_);
+                std::memcpy(cur_, data, len);
+                cur_ += len;
+                return *this;
+            }
+
+            Writer& put_varint(uint64_t v) {
+                assert(cur_ + varint_size(v) <= end_);
+                cur_ = detail::store_varint(cur_, v);
+                return *this;
+            }
+
+            Writer& put_varint_signed(int64_t v) {
+                return put_varint(detail::zigzag_encode(v));
+            }
+
+            Writer& put_string(std::string_view str) {
+                put_varint(str.size());
+                return put_bytes(str.data(), str.size());
+            }
+
+            size_t written() const {
+                return static_cast<size_t>(cur_ - begin_);
+            }
+
+            void finish() {
+                if (buffer_ != nullptr) {
+                    buffer_->has_written(written());
+                    buffer_ = nullptr;
+                }
+            }
+
+        private:
+            BasicByteBuffer* buffer_;
+            char* begin_;
+            char* cur_;
+            char* end_;
+        };
+
+        // Encoder over max_bytes of reserved space; see Writer.
+        Writer writer(size_t max_bytes) {
+            return Writer(*this, max_bytes);
+        }
+
+        static constexpr size_t varint_size(uint64_t v) {
+            size_t n = 1;
+            for (; v >= 0x80; v >>= 7) {
+                ++n;
+            }
+            return n;
         }
 
         void prepend(const void* data, size_t len) {
             assert(len <= prependable_bytes());
+            unshare();
             reader_index_ -= len;
             const char* d = static_cast<const char*>(data);
             std::copy(d, d + len, begin() + reader_index_);
         }
 
+        // Makes room for len more bytes up front, e.g. before a bulk read.
+        void reserve(size_t len) {
+            ensure_writable_bytes(len);
+        }
+
         void shrink(size_t reserve) {
-            ByteBuffer other;
-            other.ensure_writable_bytes(readable_bytes() + reserve);
-            other.append(to_string_view());
-            swap(other);
+            reallocate(prepend_size_ + readable_bytes() + reserve);
+        }
+
+        void set_shrink_policy(const ShrinkPolicy& policy) {
+            policy_ = policy;
+            drains_ = 0;
+            peak_ = 0;
+        }
+
+        const ShrinkPolicy& shrink_policy() const {
+            return policy_;
         }
 
         size_t internal_capacity() const {
-            return buffer_.capacity();
+            return capacity_;
+        }
+
+#if !defined(_WIN32)
+        /*!
+         * Reads from fd with a single readv into the writable space plus a 64 KB
+         * stack buffer, so the buffer only grows by what was actually read.
+         * \return bytes read, 0 on EOF, -1 on error with errno in *saved_errno
+         */
+        ssize_t read_fd(int fd, int* saved_errno) {
+            release_if_drained();
+            char extrabuf[65536];
+            const size_t writable = writable_bytes();
+            iovec vec[2];
+            vec[0].iov_base = begin_write();
+            vec[0].iov_len = writable;
+            vec[1].iov_base = extrabuf;
+            vec[1].iov_len = sizeof extrabuf;
+            // When there is enough space in this buffer, don't read into extrabuf.
+            const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+            const ssize_t n = ::readv(fd, vec, iovcnt);
+            if (n < 0) {
+                *saved_errno = errno;
+            } else if (static_cast<size_t>(n) <= writable) {
+                writer_index_ += static_cast<size_t>(n);
+            } else {
+                writer_index_ = capacity_;
+                append(extrabuf, static_cast<size_t>(n) - writable);
+            }
+            return n;
         }
 
+        /*!
+         * Writes the readable bytes to fd straight from the buffer and skips what
+         * was written.
+         * \return bytes written, -1 on error with errno in *saved_errno
+         */
+        ssize_t write_fd(int fd, int* saved_errno) {
+            const ssize_t n = ::write(fd, peek(), readable_bytes());
+            if (n < 0) {
+                *saved_errno = errno;
+            } else {
+                skip(static_cast<size_t>(n));
+            }
+            return n;
+        }
+#endif
+
     private:
+        using alloc_traits = std::allocator_traits<allocator_type>;
+
+        // Header of a heap block; the bytes follow it at BlockHeader.
+        struct heap_block : ::detail::shared_block {
+            heap_block(const allocator_type& a, size_t c) : alloc{a}, capacity{c} {
+                destroy = &BasicByteBuffer::destroy_block;
+            }
+
+            allocator_type alloc;
+            size_t capacity;
+        };
+
+        static constexpr size_t BlockHeader = (sizeof(heap_block) + 15) & ~size_t{15};
+
+        // The block may be larger than asked for when the allocator rounds sizes up.
+        static heap_block* make_block(const allocator_type& alloc, size_t capacity) {
+            allocator_type a{alloc};
+            const size_t size = detail::alloc_good_size(a, BlockHeader + capacity);
+            char* p = alloc_traits::allocate(a, size);
+            return ::new (static_cast<void*>(p)) heap_block(a, size - BlockHeader);
+        }
+
+        static void destroy_block(::detail::shared_block* shared) noexcept {
+            heap_block* block = static_cast<heap_block*>(shared);
+            allocator_type a{std::move(block->alloc)};
+            const size_t size = BlockHeader + block->capacity;
+            block->~heap_block();
+            alloc_traits::deallocate(a, reinterpret_cast<char*>(block), size);
+        }
+
+        static char* block_data(heap_block* block) {
+            return reinterpret_cast<char*>(block) + BlockHeader;
+        }
+
         char* begin() {
-            return buffer_.data();
+            return data_;
         }
 
         const char* begin() const {
-            return buffer_.data();
+            return data_;
+        }
+
+        // Storage for at least capacity bytes, inline when it fits; contents are undefined.
+        void allocate(size_t capacity) {
+            if (capacity <= InlineCapacity) {
+                data_ = inline_;
+                capacity_ = InlineCapacity;
+            } else {
+                block_ = make_block(alloc_, capacity);
+                data_ = block_data(block_);
+                capacity_ = block_->capacity;
+            }
+        }
+
+        // Drops this buffer's reference to its block and falls back to inline storage.
+        void deallocate() {
+            if (block_ != nullptr) {
+                block_->release();
+                block_ = nullptr;
+            }
+            data_ = inline_;
+            capacity_ = InlineCapacity;
+        }
+
+        // Moves the readable bytes into fresh storage of the given capacity.
+        void reallocate(size_t capacity) {
+            const size_t readable = readable_bytes();
+            assert(capacity >= prepend_size_ + readable);
+            if (capacity <= InlineCapacity && block_ == nullptr) {
+                std::memmove(inline_ + prepend_size_, peek(), readable);
+            } else if (capacity <= InlineCapacity) {
+                std::memcpy(inline_ + prepend_size_, peek(), readable);
+                deallocate();
+            } else {
+                heap_block* block = make_block(alloc_, capacity);
+                if (readable > 0) {
+                    std::memcpy(block_data(block) + prepend_size_, peek(), readable);
+                }
+                deallocate();
+                block_ = block;
+                data_ = block_data(block);
+                capacity_ = block->capacity;
+            }
+            reader_index_ = prepend_size_;
+            writer_index_ = prepend_size_ + readable;
+        }
+
+        // Gives the buffer a block of its own before it writes in front of the reader.
+        void unshare() {
+            if (shared()) {
+                heap_block* block = make_block(alloc_, capacity_);
+                std::memcpy(block_data(block) + reader_index_, peek(), readable_bytes());
+                block_->release();
+                block_ = block;
+                data_ = block_data(block);
+            }
         }
 
         void make_space(size_t len) {
-            if (writable_bytes() + prependable_bytes() < len + CheapPrepend) {
-                // FIXME: move readable data
-                buffer_.resize(writer_index_ + len);
+            const size_t needed = prepend_size_ + readable_bytes() + len;
+            if (shared()) {
+                // Compacting would overwrite bytes that slices still reference.
+                reallocate(std::max(capacity_, needed));
+            } else if (writable_bytes() + prependable_bytes() < len + prepend_size_) {
+                // Grow geometrically; only the readable bytes are carried over.
+                reallocate(std::max({capacity_ * 2, prepend_size_ + InitialSize, needed}));
             } else {
                 // move readable data to the front, make space inside buffer
-                assert(CheapPrepend < reader_index_);
+                assert(prepend_size_ < reader_index_);
                 size_t readable = readable_bytes();
-                std::copy(begin() + reader_index_, begin() + writer_index_, begin() + CheapPrepend);
-                reader_index_ = CheapPrepend;
+                std::memmove(begin() + prepend_size_, begin() + reader_index_, readable);
+                reader_index_ = prepend_size_;
                 writer_index_ = reader_index_ + readable;
                 assert(readable == readable_bytes());
             }
         }
 
+        // The deferred half of release_before_write; a no-op once anything was written since the drain.
+        void release_if_drained() {
+            if (release_pending_) {
+                release_pending_ = false;
+                if (readable_bytes() == 0) {
+                    deallocate();
+                    reader_index_ = writer_index_ = prepend_size_;
+                }
+            }
+        }
+
+        void note_drain() {
+            peak_ = std::max(peak_, writer_index_);
+            if (++drains_ < policy_.window) {
+                return;
+            }
+            const size_t target = std::max(peak_ * 2, policy_.min_capacity);
+            if (capacity_ > peak_ * policy_.ratio && capacity_ > target) {
+                deallocate();
+                allocate(target);
+            }
+            drains_ = 0;
+            peak_ = 0;
+        }
+
+        // Leaves rhs empty on inline storage; allocator and settings are moved by the caller.
+        void steal(BasicByteBuffer& rhs) noexcept {
+            if (rhs.block_ != nullptr) {
+                block_ = rhs.block_;
+                data_ = rhs.data_;
+                capacity_ = rhs.capacity_;
+            } else {
+                std::memcpy(inline_ + rhs.reader_index_, rhs.inline_ + rhs.reader_index_, rhs.readable_bytes());
+                data_ = inline_;
+                capacity_ = InlineCapacity;
+            }
+            reader_index_ = rhs.reader_index_;
+            writer_index_ = rhs.writer_index_;
+            release_pending_ = rhs.release_pending_;
+            rhs.release_pending_ = false;
+            rhs.block_ = nullptr;
+            rhs.data_ = rhs.inline_;
+            rhs.capacity_ = InlineCapacity;
+            rhs.reader_index_ = rhs.writer_index_ = rhs.prepend_size_;
+        }
+
     private:
-        std::vector<char> buffer_;
-        size_t reader_index_;
-        size_t writer_index_;
+        allocator_type alloc_;
+        heap_block* block_{nullptr};
+        char* data_{inline_};
+        size_t capacity_{InlineCapacity};
+        size_t reader_index_{CheapPrepend};
+        size_t writer_index_{CheapPrepend};
+        size_t prepend_size_{CheapPrepend};
+        ShrinkPolicy policy_;
+        size_t drains_{0};
+        size_t peak_{0};
+        bool release_pending_{false};
+        alignas(8) char inline_[InlineCapacity];
+    };
+
+    using ByteBuffer = BasicByteBuffer<>;
+
+    /*!
+     * \class ByteBufferChain
+     *
+     * \brief A list of ByteBuffer blocks for large or streaming payloads.
+     *
+     * Appending never moves bytes that are already stored: data fills the
+     * last block and spills into new blocks of block_size, payloads of at
+     * least block_size get a block of their own, and a whole ByteBuffer can
+     * be linked in without copying. write_fd gathers every block with one
+     * writev, read_fd scatters into the last block plus a stack buffer.
+     */
+    class ByteBufferChain {
+    public:
+        static const size_t DefaultBlockSize = 64 * 1024;
+
+        explicit ByteBufferChain(size_t block_size = DefaultBlockSize) : block_size_{block_size} {}
+
+        size_t readable_bytes() const {
+            return readable_;
+        }
+
+        bool empty() const {
+            return readable_ == 0;
+        }
+
+        size_t block_count() const {
+            return blocks_.size();
+        }
+
+        void append(std::string_view str) {
+            append(str.data(), str.size());
+        }
+
+        void append(const void* data, size_t len) {
+            const char* d = static_cast<const char*>(data);
+            if (!blocks_.empty()) {
+                const size_t n = std::min(len, blocks_.back().writable_bytes());
+                blocks_.back().append(d, n);
+                d += n;
+                len -= n;
+                readable_ += n;
+            }
+            if (len > 0) {
+                blocks_.emplace_back(std::max(len, block_size_));
+                blocks_.back().append(d, len);
+                readable_ += len;
+            }
+        }
+
+        // Links buffer in as a block of its own; its bytes are not copied.
+        void append(ByteBuffer&& buffer) {
+            if (buffer.readable_bytes() == 0) {
+                return;
+            }
+            readable_ += buffer.readable_bytes();
+            blocks_.push_back(std::move(buffer));
+        }
+
+        void skip(size_t len) {
+            assert(len <= readable_);
+            readable_ -= len;
+            while (len > 0) {
+                ByteBuffer& front = blocks_.front();
+                const size_t n = std::min(len, front.readable_bytes());
+                front.skip(n);
+                len -= n;
+                if (front.readable_bytes() == 0 && blocks_.size() > 1) {
+                    blocks_.pop_front();
+                }
+            }
+            if (readable_ == 0 && blocks_.size() == 1 && blocks_.front().internal_capacity() > block_size_ * 2) {
+                blocks_.clear();
+            }
+        }
+
+        void skip_all() {
+            blocks_.clear();
+            readable_ = 0;
+        }
+
+        // Calls f(std::string_view) for every non-empty block, in order.
+        template <typename F>
+        void for_each_block(F&& f) const {
+            for (const ByteBuffer& block : blocks_) {
+                if (block.readable_bytes() > 0) {
+                    f(block.to_string_view());
+                }
+            }
+        }
+
+        std::string read_all_as_string() {
+            std::string result;
+            result.reserve(readable_);
+            for_each_block([&result](std::string_view s) { result.append(s); });
+            skip_all();
+            return result;
+        }
+
+#if !defined(_WIN32)
+        ssize_t read_fd(int fd, int* saved_errno) {
+            char extrabuf[65536];
+            ByteBuffer* tail = blocks_.empty() ? nullptr : &blocks_.back();
+            const size_t writable = tail != nullptr ? tail->writable_bytes() : 0;
+            iovec vec[2];
+            int iovcnt = 0;
+            if (writable > 0) {
+                vec[iovcnt].iov_base = tail->begin_write();
+                vec[iovcnt].iov_len = writable;
+                ++iovcnt;
+            }
+            vec[iovcnt].iov_base = extrabuf;
+            vec[iovcnt].iov_len = sizeof extrabuf;
+            ++iovcnt;
+            const ssize_t n = ::readv(fd, vec, iovcnt);
+            if (n < 0) {
+                *saved_errno = errno;
+            } else if (n == 0) {
+                // EOF; an empty chain has no tail to advance.
+            } else if (static_cast<size_t>(n) <= writable) {
+                tail->has_written(static_cast<size_t>(n));
+                readable_ += static_cast<size_t>(n);
+            } else {
+                if (writable > 0) {
+                    tail->has_written(writable);
+                    readable_ += writable;
+                }
+                append(extrabuf, static_cast<size_t>(n) - writable);
+            }
+            return n;
+        }
+
+        // Gathers up to IOV_MAX blocks into one writev and skips what was written.
+        ssize_t write_fd(int fd, int* saved_errno) {
+            iovec vec[kMaxIov];
+            int iovcnt = 0;
+            for (const ByteBuffer& block : blocks_) {
+                if (iovcnt == kMaxIov) {
+                    break;
+                }
+                if (block.readable_bytes() > 0) {
+                    vec[iovcnt].iov_base = const_cast<char*>(block.peek());
+                    vec[iovcnt].iov_len = block.readable_bytes();
+                    ++iovcnt;
+                }
+            }
+            if (iovcnt == 0) {
+                return 0;
+            }
+            const ssize_t n = ::writev(fd, vec, iovcnt);
+            if (n < 0) {
+                *saved_errno = errno;
+            } else {
+                skip(static_cast<size_t>(n));
+            }
+            return n;
+        }
+#endif
+
+    private:
+#if !defined(_WIN32)
+        static constexpr int kMaxIov = IOV_MAX < 64 ? IOV_MAX : 64;
+#endif
+
+        std::deque<ByteBuffer> blocks_;
+        size_t block_size_;
+        size_t readable_{0};
     };
 
 } // namespace glasssix
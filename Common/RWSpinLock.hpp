@@ -0,0 +1,256 @@
+#pragma once
+
+#include "SpinLock.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace detail {
+/*!
+ Spins with PAUSE and exponential backoff until pred() returns true,
+ yielding the CPU every spin_count pause iterations.
+*/
+template <typename Pred>
+void spin_until(Pred&& pred, std::int32_t spin_count = 1024) noexcept {
+    std::int32_t counter = spin_count;
+    std::int32_t backoff = 1;
+    while (!pred()) {
+        if (counter <= 0) {
+            std::this_thread::yield();
+            counter = spin_count;
+            backoff = 1;
+            continue;
+        }
+        for (std::int32_t i = 0; i < backoff; ++i) {
+            cpu_relax();
+        }
+        counter -= backoff;
+        backoff = backoff < 64 ? backoff << 1 : 64;
+    }
+}
+
+/*!
+ Like spin_until(pred), but gives up once deadline has passed.
+ Returns whether pred() became true.
+*/
+template <typename Pred, typename Clock, typename Duration>
+bool spin_until(Pred&& pred, const std::chrono::time_point<Clock, Duration>& deadline) noexcept {
+    bool expired = false;
+    spin_until([&] { return pred() || (expired = Clock::now() >= deadline); });
+    return !expired;
+}
+} // namespace detail
+
+/*!
+ Reader-writer spin lock with shared, upgrade and exclusive states.
+
+ It satisfies the SharedMutex requirements and also provides lock_upgrade(),
+ so folly::Synchronized<T, RWSpinLock> offers wlock(), rlock() and ulock().
+
+ State word, from the low bit:
+   bit 0 : writer
+   bit 1 : upgrader
+   bit 2~: reader count
+
+ An upgrader excludes writers and other upgraders and blocks new readers, so
+ upgrading only waits for the readers already inside. Writers are preferred
+ over new readers only through the upgrade state; use it for short critical
+ sections. The lock occupies a whole cache line so that arrays of locks do not
+ false-share.
+*/
+class alignas(detail::hardware_destructive_interference_size) RWSpinLock {
+public:
+    RWSpinLock() noexcept = default;
+
+    RWSpinLock(const RWSpinLock&) = delete;
+    RWSpinLock& operator=(const RWSpinLock&) = delete;
+
+    // 独占锁
+    void lock() noexcept {
+        detail::spin_until([this] { return try_lock(); });
+    }
+
+    bool try_lock() noexcept {
+        std::int32_t expect = 0;
+        return bits_.compare_exchange_strong(expect, kWriter, std::memory_order_acq_rel);
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        return detail::spin_until([this] { return try_lock(); }, std::chrono::steady_clock::now() + timeout);
+    }
+
+    void unlock() noexcept {
+        bits_.fetch_and(~(kWriter | kUpgraded), std::memory_order_release);
+    }
+
+    // 共享锁
+    void lock_shared() noexcept {
+        detail::spin_until([this] { return try_lock_shared(); });
+    }
+
+    bool try_lock_shared() noexcept {
+        const std::int32_t value = bits_.fetch_add(kReader, std::memory_order_acquire);
+        if (value & (kWriter | kUpgraded)) {
+            bits_.fetch_add(-kReader, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        return detail::spin_until([this] { return try_lock_shared(); }, std::chrono::steady_clock::now() + timeout);
+    }
+
+    void unlock_shared() noexcept {
+        bits_.fetch_add(-kReader, std::memory_order_release);
+    }
+
+    // 可升级锁
+    void lock_upgrade() noexcept {
+        detail::spin_until([this] { return try_lock_upgrade(); });
+    }
+
+    bool try_lock_upgrade() noexcept {
+        const std::int32_t value = bits_.fetch_or(kUpgraded, std::memory_order_acquire);
+        // 失败时不回滚 UPGRADED 位：它属于已有的升级者，或者会在写者 unlock() 时一并清除
+        return (value & (kUpgraded | kWriter)) == 0;
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_upgrade_for(const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        return detail::spin_until([this] { return try_lock_upgrade(); }, std::chrono::steady_clock::now() + timeout);
+    }
+
+    void unlock_upgrade() noexcept {
+        bits_.fetch_add(-kUpgraded, std::memory_order_acq_rel);
+    }
+
+    // 状态转换
+    void unlock_upgrade_and_lock() noexcept {
+        detail::spin_until([this] {
+            std::int32_t expect = kUpgraded;
+            return bits_.compare_exchange_weak(expect, kWriter, std::memory_order_acq_rel);
+        });
+    }
+
+    void unlock_upgrade_and_lock_shared() noexcept {
+        bits_.fetch_add(kReader - kUpgraded, std::memory_order_acq_rel);
+    }
+
+    void unlock_and_lock_upgrade() noexcept {
+        // 先置 UPGRADED 位，避免其他升级者在两步之间插入
+        bits_.fetch_or(kUpgraded, std::memory_order_acquire);
+        bits_.fetch_add(-kWriter, std::memory_order_release);
+    }
+
+    void unlock_and_lock_shared() noexcept {
+        bits_.fetch_add(kReader, std::memory_order_acquire);
+        unlock();
+    }
+
+private:
+    static constexpr std::int32_t kReader = 4;
+    static constexpr std::int32_t kUpgraded = 2;
+    static constexpr std::int32_t kWriter = 1;
+
+    std::atomic<std::int32_t> bits_{0};
+};
+
+/*!
+ Reader-writer spin lock with per-CPU reader counters, for read-mostly data.
+
+ Each reader only touches the counter slot of the CPU it runs on, so readers
+ on different cores never contend on a cache line. Writers are expensive:
+ they raise a flag and then wait until the sum of all slots drops to zero.
+ A reader may migrate between lock_shared() and unlock_shared(); slots are
+ signed and only their sum is meaningful.
+
+ @tparam Slots  number of reader slots; should be >= the number of CPUs.
+*/
+template <std::size_t Slots = 64>
+class DistributedRWSpinLock {
+public:
+    DistributedRWSpinLock() noexcept = default;
+
+    DistributedRWSpinLock(const DistributedRWSpinLock&) = delete;
+    DistributedRWSpinLock& operator=(const DistributedRWSpinLock&) = delete;
+
+    // 独占锁
+    void lock() noexcept {
+        detail::spin_until([this] { return !writer_.exchange(true, std::memory_order_seq_cst); });
+        detail::spin_until([this] { return readers() == 0; });
+    }
+
+    bool try_lock() noexcept {
+        if (writer_.exchange(true, std::memory_order_seq_cst)) {
+            return false;
+        }
+        if (readers() != 0) {
+            writer_.store(false, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    void unlock() noexcept {
+        writer_.store(false, std::memory_order_release);
+    }
+
+    // 共享锁
+    void lock_shared() noexcept {
+        detail::spin_until([this] { return try_lock_shared(); });
+    }
+
+    bool try_lock_shared() noexcept {
+        std::atomic<std::int64_t>& slot = slots_[current_slot()].count;
+        // 与写者的 writer_ 标志构成 Dekker 式同步，两侧都需要 seq_cst
+        slot.fetch_add(1, std::memory_order_seq_cst);
+        if (writer_.load(std::memory_order_seq_cst)) {
+            slot.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    void unlock_shared() noexcept {
+        slots_[current_slot()].count.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    struct alignas(detail::hardware_destructive_interference_size) Slot {
+        std::atomic<std::int64_t> count{0};
+    };
+
+    static std::size_t current_slot() noexcept {
+#if defined(__linux__)
+        const int cpu = sched_getcpu();
+        if (cpu >= 0) {
+            return static_cast<std::size_t>(cpu) % Slots;
+        }
+#endif
+        thread_local const std::size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id()) % Slots;
+        return slot;
+    }
+
+    std::int64_t readers() const noexcept {
+        std::int64_t sum = 0;
+        for (const Slot& slot : slots_) {
+            sum += slot.count.load(std::memory_order_seq_cst);
+        }
+        return sum;
+    }
+
+    alignas(detail::hardware_destructive_interference_size) std::atomic<bool> writer_{false};
+    std::array<Slot, Slots> slots_;
+};
@@ -3,34 +3,161 @@
 //
 
 #pragma once
+#include "SpinLock.hpp"
+
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <thread>
 
-class Rate {
+#if defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#endif
+
+enum class rate_mode {
+    sleep,   // std::this_thread::sleep_for, cheap but overshoots by tens of microseconds
+    precise, // absolute clock_nanosleep until spin_margin before the deadline, then spin
+};
+
+enum class overrun_policy {
+    catch_up, // keep the original schedule, late cycles follow each other without waiting
+    skip,     // drop the missed cycles and realign to the next future deadline
+};
+
+/*!
+ * Wake-up lateness (actual wake time - deadline) and overrun counters.
+ * An overrun is a cycle whose work ended after its deadline.
+ */
+struct rate_stats {
+    std::uint64_t cycles{0};
+    std::uint64_t overruns{0};
+    std::uint64_t skipped_cycles{0};
+    double mean_jitter_us{0};
+    double stddev_jitter_us{0};
+    double max_jitter_us{0};
+};
+
+/*!
+ * @tparam Clock steady clock used to measure the cycle, e.g. std::chrono::steady_clock or tsc_clock
+ */
+template <typename Clock = std::chrono::steady_clock>
+class basic_rate {
 public:
     /*!
      * @param frequency unit:Hz
+     * @param mode rate_mode::precise for 1-10 kHz loops; it burns up to spin_margin of CPU per cycle
+     * @param policy what to do when a cycle overruns its deadline
+     * @param spin_margin how long before the deadline the precise mode stops sleeping and starts spinning
      */
-    explicit Rate(double frequency) : desired_cycle_time_(1000.0 / frequency) {
-        start_time_ = std::chrono::steady_clock::now();
+    explicit basic_rate(double frequency, rate_mode mode = rate_mode::sleep,
+        overrun_policy policy = overrun_policy::catch_up,
+        std::chrono::nanoseconds spin_margin = std::chrono::microseconds{100})
+        : cycle_{std::chrono::duration_cast<typename Clock::duration>(MilliDuration{1000.0 / frequency})}, mode_{mode},
+          policy_{policy}, spin_margin_{spin_margin} {
+        start_time_ = Clock::now();
     }
 
-    Rate(Rate&&) = default;
-    Rate& operator=(Rate&&) = default;
-    Rate& operator=(const Rate&) = delete;
-    Rate(const Rate&) = delete;
+    basic_rate(basic_rate&&) = default;
+    basic_rate& operator=(basic_rate&&) = default;
+    basic_rate& operator=(const basic_rate&) = delete;
+    basic_rate(const basic_rate&) = delete;
 
-    void sleep() {
-        const MilliDuration cycle_duration{std::chrono::high_resolution_clock::now() - start_time_};
-        const MilliDuration sleep_duration{desired_cycle_time_ - cycle_duration};
-        if (sleep_duration > MilliDuration{}) {
-            std::this_thread::sleep_for(sleep_duration);
+    /*!
+     * Waits for the end of the current cycle.
+     * @return false if the cycle overran its deadline
+     */
+    bool sleep() {
+        const auto deadline = start_time_ + cycle_;
+        const auto now = Clock::now();
+        ++stats_.cycles;
+
+        if (now > deadline) {
+            ++stats_.overruns;
+            start_time_ = deadline;
+            if (policy_ == overrun_policy::skip) {
+                // Move to the cycle that contains now; the ones in between are dropped.
+                const auto missed = (now - deadline) / cycle_;
+                stats_.skipped_cycles += static_cast<std::uint64_t>(missed);
+                start_time_ += cycle_ * missed;
+            }
+            return false;
         }
-        start_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(desired_cycle_time_);
+
+        if (mode_ == rate_mode::precise) {
+            wait_precise(deadline);
+        } else {
+            std::this_thread::sleep_for(MilliDuration{deadline - now});
+        }
+        record_jitter(Clock::now() - deadline);
+        start_time_ = deadline;
+        return true;
+    }
+
+    // Restarts the schedule from now, e.g. after the loop was paused.
+    void reset() {
+        start_time_ = Clock::now();
+    }
+
+    const rate_stats& stats() const {
+        return stats_;
+    }
+
+    void reset_stats() {
+        stats_ = rate_stats{};
+        jitter_m2_ = 0;
+    }
+
+    typename Clock::duration cycle_time() const {
+        return cycle_;
     }
 
 private:
     using MilliDuration = std::chrono::duration<double, std::milli>;
-    std::chrono::steady_clock::time_point start_time_;
-    MilliDuration desired_cycle_time_;
+
+    void wait_precise(typename Clock::time_point deadline) {
+        const auto sleep_for = deadline - spin_margin_ - Clock::now();
+        if (sleep_for > Clock::duration::zero()) {
+#if defined(__linux__)
+            // Absolute wake-up time on CLOCK_MONOTONIC: immune to the drift of repeated relative sleeps and to EINTR.
+            timespec target{};
+            clock_gettime(CLOCK_MONOTONIC, &target);
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sleep_for).count();
+            target.tv_sec += static_cast<time_t>(ns / 1000000000);
+            target.tv_nsec += static_cast<long>(ns % 1000000000);
+            if (target.tv_nsec >= 1000000000) {
+                ++target.tv_sec;
+                target.tv_nsec -= 1000000000;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, nullptr) == EINTR) {}
+#else
+            std::this_thread::sleep_for(sleep_for);
+#endif
+        }
+        while (Clock::now() < deadline) {
+            detail::cpu_relax();
+        }
+    }
+
+    void record_jitter(typename Clock::duration lateness) {
+        const double us = std::max(std::chrono::duration<double, std::micro>(lateness).count(), 0.0);
+        // Welford's online mean/variance.
+        const double n = static_cast<double>(stats_.cycles - stats_.overruns);
+        const double delta = us - stats_.mean_jitter_us;
+        stats_.mean_jitter_us += delta / n;
+        jitter_m2_ += delta * (us - stats_.mean_jitter_us);
+        stats_.stddev_jitter_us = n > 1 ? std::sqrt(jitter_m2_ / (n - 1)) : 0.0;
+        stats_.max_jitter_us = std::max(stats_.max_jitter_us, us);
+    }
+
+    typename Clock::time_point start_time_;
+    typename Clock::duration cycle_;
+    rate_mode mode_;
+    overrun_policy policy_;
+    std::chrono::nanoseconds spin_margin_;
+    rate_stats stats_;
+    double jitter_m2_{0};
 };
+
+using Rate = basic_rate<>;
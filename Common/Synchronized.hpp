@@ -7,8 +7,15 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -35,17 +42,26 @@ namespace detail {
     template <typename Mutex>
     inline constexpr bool kSynchronizedMutexIsShared<decltype(void(std::declval<Mutex&>().lock_shared())), Mutex> = true;
 
+    template <typename, typename Mutex>
+    inline constexpr bool kSynchronizedMutexIsUpgrade = false;
+    template <typename Mutex>
+    inline constexpr bool kSynchronizedMutexIsUpgrade<decltype(void(std::declval<Mutex&>().lock_upgrade())), Mutex> =
+        true;
 
     /**
      * 用于描述互斥锁“级别”的枚举。支持的级别包括
      *  Unique - 仅支持独占锁定的普通互斥锁
      *  Shared - 具有共享锁定和解锁功能的共享互斥锁；
+     *  Upgrade - 在共享互斥锁的基础上还支持可升级锁定（lock_upgrade()）的互斥锁；
      */
-    enum class SynchronizedMutexLevel { Unique, Shared };
+    enum class SynchronizedMutexLevel { Unique, Shared, Upgrade };
 
     template <typename Mutex>
-    inline constexpr SynchronizedMutexLevel kSynchronizedMutexLevel =
-        kSynchronizedMutexIsShared<void, Mutex> ? SynchronizedMutexLevel::Shared : SynchronizedMutexLevel::Unique;
+    inline constexpr SynchronizedMutexLevel kSynchronizedMutexLevel = kSynchronizedMutexIsUpgrade<void, Mutex>
+                                                                          ? SynchronizedMutexLevel::Upgrade
+                                                                      : kSynchronizedMutexIsShared<void, Mutex>
+                                                                          ? SynchronizedMutexLevel::Shared
+                                                                          : SynchronizedMutexLevel::Unique;
 
     enum class SynchronizedMutexMethod { Lock, TryLock };
 
@@ -59,6 +75,98 @@ namespace detail {
     using SynchronizedLockPolicyTryExclusive = SynchronizedLockPolicy<SynchronizedMutexLevel::Unique, SynchronizedMutexMethod::TryLock>;
     using SynchronizedLockPolicyShared = SynchronizedLockPolicy<SynchronizedMutexLevel::Shared, SynchronizedMutexMethod::Lock>;
     using SynchronizedLockPolicyTryShared = SynchronizedLockPolicy<SynchronizedMutexLevel::Shared, SynchronizedMutexMethod::TryLock>;
+    using SynchronizedLockPolicyUpgrade = SynchronizedLockPolicy<SynchronizedMutexLevel::Upgrade, SynchronizedMutexMethod::Lock>;
+    using SynchronizedLockPolicyTryUpgrade = SynchronizedLockPolicy<SynchronizedMutexLevel::Upgrade, SynchronizedMutexMethod::TryLock>;
+
+    /**
+     * 可升级锁的 RAII 包装，接口与 std::unique_lock / std::shared_lock 保持一致。
+     *
+     * 持有可升级锁时，其他线程仍然可以获取共享锁，但不能获取独占锁或另一个可升级锁。
+     */
+    template <typename Mutex>
+    class upgrade_lock {
+    public:
+        using mutex_type = Mutex;
+
+        upgrade_lock() noexcept = default;
+
+        explicit upgrade_lock(mutex_type& mutex) : mutex_{&mutex}, owns_{true} {
+            mutex_->lock_upgrade();
+        }
+
+        upgrade_lock(mutex_type& mutex, std::try_to_lock_t) : mutex_{&mutex}, owns_{mutex.try_lock_upgrade()} {}
+
+        upgrade_lock(mutex_type& mutex, std::adopt_lock_t) noexcept : mutex_{&mutex}, owns_{true} {}
+
+        template <typename Rep, typename Period>
+        upgrade_lock(mutex_type& mutex, const std::chrono::duration<Rep, Period>& timeout)
+            : mutex_{&mutex}, owns_{mutex.try_lock_upgrade_for(timeout)} {}
+
+        upgrade_lock(upgrade_lock&& other) noexcept
+            : mutex_{std::exchange(other.mutex_, nullptr)}, owns_{std::exchange(other.owns_, false)} {}
+
+        upgrade_lock& operator=(upgrade_lock&& other) noexcept {
+            if (this != &other) {
+                if (owns_) {
+                    mutex_->unlock_upgrade();
+                }
+                mutex_ = std::exchange(other.mutex_, nullptr);
+                owns_ = std::exchange(other.owns_, false);
+            }
+            return *this;
+        }
+
+        upgrade_lock(const upgrade_lock&) = delete;
+        upgrade_lock& operator=(const upgrade_lock&) = delete;
+
+        ~upgrade_lock() {
+            if (owns_) {
+                mutex_->unlock_upgrade();
+            }
+        }
+
+        void lock() {
+            assert(mutex_ && !owns_);
+            mutex_->lock_upgrade();
+            owns_ = true;
+        }
+
+        bool try_lock() {
+            assert(mutex_ && !owns_);
+            owns_ = mutex_->try_lock_upgrade();
+            return owns_;
+        }
+
+        void unlock() {
+            assert(owns_);
+            mutex_->unlock_upgrade();
+            owns_ = false;
+        }
+
+        /**
+         * 放弃对互斥量的所有权但不解锁，由调用方负责后续的状态转换或解锁。
+         */
+        mutex_type* release() noexcept {
+            owns_ = false;
+            return std::exchange(mutex_, nullptr);
+        }
+
+        mutex_type* mutex() const noexcept {
+            return mutex_;
+        }
+
+        bool owns_lock() const noexcept {
+            return owns_;
+        }
+
+        explicit operator bool() const noexcept {
+            return owns_;
+        }
+
+    private:
+        mutex_type* mutex_{nullptr};
+        bool owns_{false};
+    };
 
     template <SynchronizedMutexLevel>
     struct SynchronizedLockType_ {};
@@ -75,6 +183,12 @@ namespace detail {
         using apply = std::shared_lock<Mutex>;
     };
 
+    template <>
+    struct SynchronizedLockType_<SynchronizedMutexLevel::Upgrade> {
+        template <typename Mutex>
+        using apply = upgrade_lock<Mutex>;
+    };
+
     template <SynchronizedMutexLevel Level, typename MutexType>
     using SynchronizedLockType = typename SynchronizedLockType_<Level>::template apply<MutexType>;
 } // namespace detail
@@ -299,6 +413,113 @@ public:
     }
 };
 
+/**
+ * SynchronizedBase 专门用于可升级互斥类型。
+ *
+ * 在 wlock() 和 rlock() 的基础上额外提供 ulock() 方法。可升级锁与共享锁并存，但与独占锁和其他可升级锁互斥，
+ * 因此适合“先读取，必要时再写入”的场景：持有可升级锁读取数据，需要修改时调用
+ * LockedPtr::move_from_upgrade_to_write() 原子地升级为独占锁，期间数据不会被其他写者修改。
+ */
+template <typename Subclass>
+class SynchronizedBase<Subclass, detail::SynchronizedMutexLevel::Upgrade>
+    : public SynchronizedBase<Subclass, detail::SynchronizedMutexLevel::Shared> {
+private:
+    template <typename T, typename P>
+    using LockedPtr_ = ::folly::LockedPtr<T, P>;
+
+public:
+    using LockPolicyUpgrade = detail::SynchronizedLockPolicyUpgrade;
+    using LockPolicyTryUpgrade = detail::SynchronizedLockPolicyTryUpgrade;
+
+    using UpgradeLockedPtr = LockedPtr_<Subclass, LockPolicyUpgrade>;
+    using ConstUpgradeLockedPtr = LockedPtr_<const Subclass, LockPolicyUpgrade>;
+
+    using TryUpgradeLockedPtr = LockedPtr_<Subclass, LockPolicyTryUpgrade>;
+    using ConstTryUpgradeLockedPtr = LockedPtr_<const Subclass, LockPolicyTryUpgrade>;
+
+    /**
+     * @brief 获取可升级锁。
+     *
+     * 返回的 LockedPtr 只提供对数据的 const 访问，可以通过 move_from_upgrade_to_write() 升级为独占锁，
+     * 或通过 move_from_upgrade_to_read() 降级为读锁。
+     *
+     * @methodset Upgrade lock
+     */
+    UpgradeLockedPtr ulock() {
+        return UpgradeLockedPtr(static_cast<Subclass*>(this));
+    }
+
+    ConstUpgradeLockedPtr ulock() const {
+        return ConstUpgradeLockedPtr(static_cast<const Subclass*>(this));
+    }
+
+    /**
+     * @brief 获取可升级锁，或者为空。
+     *
+     * （使用 LockedPtr::operator bool() 或 LockedPtr::isNull() 来检查有效性。）
+     *
+     * @methodset Upgrade lock
+     */
+    TryUpgradeLockedPtr try_ulock() {
+        return TryUpgradeLockedPtr{static_cast<Subclass*>(this)};
+    }
+
+    ConstTryUpgradeLockedPtr try_ulock() const {
+        return ConstTryUpgradeLockedPtr{static_cast<const Subclass*>(this)};
+    }
+
+    /**
+     * 尝试获取可升级锁，如果先超时则失败。如果获取不成功，则返回的 LockedPtr 将为 null。
+     *
+     * @methodset Upgrade lock
+     */
+    template <typename Rep, typename Period>
+    UpgradeLockedPtr ulock(const std::chrono::duration<Rep, Period>& timeout) {
+        return UpgradeLockedPtr(static_cast<Subclass*>(this), timeout);
+    }
+
+    template <typename Rep, typename Period>
+    ConstUpgradeLockedPtr ulock(const std::chrono::duration<Rep, Period>& timeout) const {
+        return ConstUpgradeLockedPtr(static_cast<const Subclass*>(this), timeout);
+    }
+
+    /**
+     * 在持有可升级锁的情况下调用一个函数。
+     *
+     * 对数据的 const 引用将作为其唯一参数传递到函数中。
+     *
+     * @methodset Upgrade lock
+     */
+    template <typename Function>
+    auto with_ulock(Function&& function) const {
+        return function(*ulock());
+    }
+
+    /**
+     * 在持有可升级锁的情况下调用一个函数。
+     *
+     * 函数将传递 LockedPtr 而不是对数据本身的引用，从而可以在函数内升级锁。例如：
+     *
+     *   obj.with_ulock_ptr([](auto&& ulock) {
+     *     if (ulock->needs_update()) {
+     *       auto wlock = ulock.move_from_upgrade_to_write();
+     *       wlock->update();
+     *     }
+     *   });
+     *
+     * @methodset Upgrade lock
+     */
+    template <typename Function>
+    auto with_ulock_ptr(Function&& function) {
+        return function(ulock());
+    }
+
+    template <typename Function>
+    auto with_ulock_ptr(Function&& function) const {
+        return function(ulock());
+    }
+};
+
 /**
  * SynchronizedBase 专门用于非共享互斥类型。
  *
@@ -709,28 +930,60 @@ namespace detail {
     auto wlock(Synchronized& synchronized, Args&&... args) {
         return detail::makeSynchronizedLocker(
             synchronized, [](auto& s, auto&&... a) { return s.wlock(std::forward<decltype(a)>(a)...); },
-            [](auto& s) { return s.tryWLock(); }, std::forward<Args>(args)...);
+            [](auto& s) { return s.try_wlock(); }, std::forward<Args>(args)...);
     }
 
     template <typename Synchronized, typename... Args>
     auto rlock(Synchronized& synchronized, Args&&... args) {
         return detail::makeSynchronizedLocker(
             synchronized, [](auto& s, auto&&... a) { return s.rlock(std::forward<decltype(a)>(a)...); },
-            [](auto& s) { return s.tryRLock(); }, std::forward<Args>(args)...);
+            [](auto& s) { return s.try_rlock(); }, std::forward<Args>(args)...);
     }
 
     template <typename Synchronized, typename... Args>
     auto ulock(Synchronized& synchronized, Args&&... args) {
         return detail::makeSynchronizedLocker(
             synchronized, [](auto& s, auto&&... a) { return s.ulock(std::forward<decltype(a)>(a)...); },
-            [](auto& s) { return s.tryULock(); }, std::forward<Args>(args)...);
+            [](auto& s) { return s.try_ulock(); }, std::forward<Args>(args)...);
     }
 
     template <typename Synchronized, typename... Args>
     auto lock(Synchronized& synchronized, Args&&... args) {
         return detail::makeSynchronizedLocker(
             synchronized, [](auto& s, auto&&... a) { return s.lock(std::forward<decltype(a)>(a)...); },
-            [](auto& s) { return s.tryLock(); }, std::forward<Args>(args)...);
+            [](auto& s) { return s.try_lock(); }, std::forward<Args>(args)...);
+    }
+
+    /*
+     * 按 contextual_lock() 的语义加锁：共享互斥量在 const 对象上取读锁，其余情况取独占锁。
+     */
+    template <typename Synchronized>
+    auto contextual_lock(Synchronized& synchronized) {
+        return detail::makeSynchronizedLocker(
+            synchronized, [](auto& s) { return s.contextual_lock(); },
+            [](auto& s) {
+                using SyncType = std::remove_reference_t<decltype(s)>;
+                if constexpr (kSynchronizedMutexLevel<typename SyncType::MutexType> == SynchronizedMutexLevel::Unique) {
+                    return s.try_lock();
+                } else if constexpr (std::is_const_v<SyncType>) {
+                    return s.try_rlock();
+                } else {
+                    return s.try_wlock();
+                }
+            });
+    }
+
+    /*
+     * 对 tuple 中的每个元素依次调用 func(element, index)，func 返回 false 时停止遍历。
+     */
+    template <typename Tuple, typename Func, std::size_t... Indices>
+    void for_each_until(Tuple& tuple, Func&& func, std::index_sequence<Indices...>) {
+        (void)(func(std::get<Indices>(tuple), std::integral_constant<std::size_t, Indices>{}) && ...);
+    }
+
+    template <typename Tuple, typename Func>
+    void for_each_until(Tuple& tuple, Func&& func) {
+        for_each_until(tuple, std::forward<Func>(func), std::make_index_sequence<std::tuple_size_v<Tuple>>{});
     }
 } // namespace detail
 
@@ -741,7 +994,7 @@ template <typename SynchronizedType, typename LockPolicy>
 class ScopedUnlocker {
 public:
     explicit ScopedUnlocker(LockedPtr<SynchronizedType, LockPolicy>* p) noexcept : ptr_(p), parent_(p->parent()) {
-        ptr_->releaseLock();
+        ptr_->release_lock();
     }
 
     ScopedUnlocker(const ScopedUnlocker&) = delete;
@@ -755,7 +1008,7 @@ public:
 
     ~ScopedUnlocker() noexcept(false) {
         if (ptr_) {
-            ptr_->reacquireLock(parent_);
+            ptr_->reacquire_lock(parent_);
         }
     }
 
@@ -924,6 +1177,67 @@ public:
         return parent()->data_;
     }
 
+    /**
+     * @brief 将可升级锁原子地升级为独占锁。
+     *
+     * 升级期间数据不会被其他写者修改，因此持有可升级锁时读取到的状态在升级后依然有效。
+     * 调用后当前 LockedPtr 变为 null，锁的所有权转移到返回的 LockedPtr。
+     */
+    template <typename LP = LockPolicy, std::enable_if_t<LP::level == detail::SynchronizedMutexLevel::Upgrade, int> = 0>
+    LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyExclusive> move_from_upgrade_to_write() {
+        assert(lock_.owns_lock());
+        MutexType* mutex = lock_.release();
+        mutex->unlock_upgrade_and_lock();
+        return LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyExclusive>(
+            std::unique_lock<MutexType>{*mutex, std::adopt_lock});
+    }
+
+    /**
+     * @brief 将可升级锁原子地降级为读锁。
+     */
+    template <typename LP = LockPolicy, std::enable_if_t<LP::level == detail::SynchronizedMutexLevel::Upgrade, int> = 0>
+    LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyShared> move_from_upgrade_to_read() {
+        assert(lock_.owns_lock());
+        MutexType* mutex = lock_.release();
+        mutex->unlock_upgrade_and_lock_shared();
+        return LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyShared>(
+            std::shared_lock<MutexType>{*mutex, std::adopt_lock});
+    }
+
+    /**
+     * @brief 将独占锁原子地降级为可升级锁。
+     *
+     * 仅当互斥量支持可升级锁定时可用。
+     */
+    template <typename LP = LockPolicy, typename MT = MutexType,
+        std::enable_if_t<LP::level == detail::SynchronizedMutexLevel::Unique &&
+                             detail::kSynchronizedMutexIsUpgrade<void, MT>,
+            int> = 0>
+    LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyUpgrade> move_from_write_to_upgrade() {
+        assert(lock_.owns_lock());
+        MutexType* mutex = lock_.release();
+        mutex->unlock_and_lock_upgrade();
+        return LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyUpgrade>(
+            detail::upgrade_lock<MutexType>{*mutex, std::adopt_lock});
+    }
+
+    /**
+     * @brief 将独占锁原子地降级为读锁。
+     *
+     * 仅当互斥量支持可升级锁定时可用。
+     */
+    template <typename LP = LockPolicy, typename MT = MutexType,
+        std::enable_if_t<LP::level == detail::SynchronizedMutexLevel::Unique &&
+                             detail::kSynchronizedMutexIsUpgrade<void, MT>,
+            int> = 0>
+    LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyShared> move_from_write_to_read() {
+        assert(lock_.owns_lock());
+        MutexType* mutex = lock_.release();
+        mutex->unlock_and_lock_shared();
+        return LockedPtr<SynchronizedType, detail::SynchronizedLockPolicyShared>(
+            std::shared_lock<MutexType>{*mutex, std::adopt_lock});
+    }
+
     /**
      * 暂时解锁LockedPtr，并将其重置为空。
      *
@@ -971,4 +1285,250 @@ private:
 
     LockType lock_;
 };
+
+using detail::lock;
+using detail::rlock;
+using detail::ulock;
+using detail::wlock;
+
+/**
+ * @brief 无死锁地同时获取多个锁。
+ *
+ * 参数为 wlock()/rlock()/ulock()/lock() 返回的 locker，返回与之一一对应的 LockedPtr 元组。
+ *
+ *   auto [a, b] = folly::lock(folly::wlock(s1), folly::rlock(s2));
+ *
+ * 算法：阻塞获取其中一个锁，然后对其余的锁调用 try_lock；如果某个锁获取失败，则释放全部已持有的锁，
+ * 让出 CPU，再阻塞等待失败的那个锁，并以它为起点重新尝试。这样不依赖调用方的加锁顺序，也不会出现死锁。
+ */
+template <typename... SynchronizedLocker>
+auto lock(SynchronizedLocker... lockers_in) -> std::tuple<typename SynchronizedLocker::LockedPtr...> {
+    static_assert(sizeof...(SynchronizedLocker) > 0, "lock() requires at least one locker");
+    using LockedPtrs = std::tuple<typename SynchronizedLocker::LockedPtr...>;
+
+    auto lockers = std::forward_as_tuple(lockers_in...);
+    LockedPtrs locked_ptrs{};
+
+    std::get<0>(locked_ptrs) = std::get<0>(lockers).lock();
+    std::size_t index_locked{0};
+
+    while (true) {
+        bool locked_all{true};
+
+        detail::for_each_until(lockers, [&](auto& locker, auto index) {
+            if (index == index_locked) {
+                return true;
+            }
+
+            auto locked_ptr = locker.try_lock();
+            if (!locked_ptr) {
+                // 释放已持有的锁，阻塞在获取失败的锁上，下一轮以它为起点
+                locked_ptrs = LockedPtrs{};
+                std::this_thread::yield();
+                std::get<decltype(index)::value>(locked_ptrs) = locker.lock();
+                index_locked = index;
+                locked_all = false;
+                return false;
+            }
+
+            std::get<decltype(index)::value>(locked_ptrs) = std::move(locked_ptr);
+            return true;
+        });
+
+        if (locked_all) {
+            return locked_ptrs;
+        }
+    }
+}
+
+/**
+ * @brief 在同时持有多个锁的情况下调用一个函数。
+ *
+ * 锁的获取方式与 lock(lockers...) 相同，函数的参数为对应的 LockedPtr。例如：
+ *
+ *   folly::synchronized([](auto a, auto b) { a->push_back(b->front()); }, folly::wlock(s1), folly::rlock(s2));
+ */
+template <typename Func, typename... SynchronizedLockers>
+decltype(auto) synchronized(Func&& func, SynchronizedLockers&&... lockers) {
+    // 以右值传入 locker，避免与 detail::lock(Synchronized&, ...) 产生重载歧义
+    return std::apply(std::forward<Func>(func),
+        ::folly::lock(std::decay_t<SynchronizedLockers>(std::forward<SynchronizedLockers>(lockers))...));
+}
+
+/**
+ * @brief 无死锁地同时锁定多个 Synchronized 对象。
+ *
+ * 每个对象按 contextual_lock() 的语义加锁（const 共享对象取读锁，否则取独占锁），返回 LockedPtr 元组：
+ *
+ *   auto [p1, p2] = folly::acquire_locked(s1, s2);
+ *
+ * 两个对象时按地址递增顺序加锁，与 Synchronized::swap() 一致；更多对象时使用 lock() 的 try-lock/退避算法。
+ */
+template <typename... Syncs>
+auto acquire_locked(Syncs&... syncs) {
+    static_assert(sizeof...(Syncs) > 0, "acquire_locked() requires at least one Synchronized");
+    return lock(detail::contextual_lock(syncs)...);
+}
+
+template <typename Sync1, typename Sync2>
+auto acquire_locked(Sync1& l1, Sync2& l2) {
+    assert(static_cast<const void*>(&l1) != static_cast<const void*>(&l2));
+    if (static_cast<const void*>(&l1) < static_cast<const void*>(&l2)) {
+        auto p1 = l1.contextual_lock();
+        auto p2 = l2.contextual_lock();
+        return std::make_tuple(std::move(p1), std::move(p2));
+    }
+    auto p2 = l2.contextual_lock();
+    auto p1 = l1.contextual_lock();
+    return std::make_tuple(std::move(p1), std::move(p2));
+}
+
+/**
+ * `SeqLockSynchronized` 是面向读多写少场景的 Synchronized 变体，要求 T 可平凡复制。
+ *
+ * 写者在互斥锁保护下将序列号置为奇数、写入数据、再将序列号置为偶数；读者不加锁，在复制数据前后各读取一次序列号，
+ * 两次结果不一致或为奇数时重试。读路径不写任何共享内存，因此大量读者并发读取时不会产生缓存行争用。
+ *
+ * 适用于配置快照等体积较小、极少修改但频繁读取的结构体。数据以原子字的形式存储，读写均无数据竞争。
+ *
+ * @tparam T  要存储的数据的类型。必须是可平凡复制的。
+ * @tparam Mutex  串行化写者的互斥类型。
+ */
+template <typename T, typename Mutex = std::mutex>
+class SeqLockSynchronized {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLockSynchronized requires a trivially copyable type");
+    static_assert(std::is_default_constructible_v<T>, "SeqLockSynchronized requires a default constructible type");
+
+public:
+    using DataType = T;
+    using MutexType = Mutex;
+
+    SeqLockSynchronized() : SeqLockSynchronized(T{}) {}
+
+    explicit SeqLockSynchronized(const T& value) {
+        store_words(value);
+    }
+
+    SeqLockSynchronized(const SeqLockSynchronized&) = delete;
+    SeqLockSynchronized& operator=(const SeqLockSynchronized&) = delete;
+
+    /**
+     * 锁定写者互斥量，分配数据。
+     */
+    SeqLockSynchronized& operator=(const T& rhs) {
+        store(rhs);
+        return *this;
+    }
+
+    /**
+     * @brief 读取数据的一致副本。
+     *
+     * 与写者并发时自动重试，直到读取到完整的快照。
+     */
+    T copy() const {
+        T result;
+        copy_into(result);
+        return result;
+    }
+
+    void copy_into(T& target) const {
+        while (!try_copy_into(target)) {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief 尝试读取一次数据。
+     *
+     * 如果期间有写者在写入数据，则返回 false 且 target 保持不变。
+     */
+    bool try_copy_into(T& target) const {
+        const std::uint64_t seq = seq_.load(std::memory_order_acquire);
+        if (seq & 1) {
+            return false;
+        }
+
+        std::uintptr_t words[kWords];
+        for (std::size_t i = 0; i < kWords; ++i) {
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) != seq) {
+            return false;
+        }
+
+        std::memcpy(&target, words, sizeof(T));
+        return true;
+    }
+
+    /**
+     * 锁定写者互斥量，写入新数据。
+     */
+    void store(const T& value) {
+        std::lock_guard<Mutex> guard(mutex_);
+        publish(value);
+    }
+
+    /**
+     * @brief 在写者互斥量保护下读取-修改-写入数据。
+     *
+     * 函数接收当前数据副本的引用，返回后修改结果被一次性发布给读者。例如：
+     *
+     *   config.with_wlock([](auto& cfg) { cfg.timeout_ms = 200; });
+     */
+    template <typename Function>
+    auto with_wlock(Function&& function) {
+        std::lock_guard<Mutex> guard(mutex_);
+        T value;
+        std::memcpy(&value, load_words().data(), sizeof(T));
+        if constexpr (std::is_void_v<std::invoke_result_t<Function&, T&>>) {
+            function(value);
+            publish(value);
+        } else {
+            auto result = function(value);
+            publish(value);
+            return result;
+        }
+    }
+
+    /**
+     * 当前序列号。每次写入后递增 2，奇数表示正在写入。
+     */
+    std::uint64_t sequence() const {
+        return seq_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uintptr_t) - 1) / sizeof(std::uintptr_t);
+
+    // 仅由持有 mutex_ 的写者或构造函数调用
+    std::array<std::uintptr_t, kWords> load_words() const {
+        std::array<std::uintptr_t, kWords> words{};
+        for (std::size_t i = 0; i < kWords; ++i) {
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        return words;
+    }
+
+    void store_words(const T& value) {
+        std::uintptr_t words[kWords]{};
+        std::memcpy(words, &value, sizeof(T));
+        for (std::size_t i = 0; i < kWords; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    void publish(const T& value) {
+        const std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    // 序列号与数据放在同一缓存行起始处，读者只需读取这部分内存
+    alignas(64) std::atomic<std::uint64_t> seq_{0};
+    std::atomic<std::uintptr_t> words_[kWords];
+    Mutex mutex_;
+};
 }
@@ -93,7 +93,7 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::inv
     return res;
 }
 
-void ThreadPool::wait_for_done() {
+inline void ThreadPool::wait_for_done() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         stop = true;
@@ -105,7 +105,7 @@ void ThreadPool::wait_for_done() {
     }
 }
 
-void ThreadPool::terminate() {
+inline void ThreadPool::terminate() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         decltype(tasks) tmp;
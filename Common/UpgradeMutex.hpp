@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+
+/**
+ * 支持共享、可升级、独占三种锁定级别的互斥量，可作为 folly::Synchronized 的 Mutex 参数以启用 ulock()。
+ *
+ * 实现基于一个 std::timed_mutex（升级门）和一个 std::shared_timed_mutex：
+ *  - 共享锁只锁定 std::shared_timed_mutex；
+ *  - 可升级锁只持有升级门，因此与共享锁并存，但与独占锁及其他可升级锁互斥；
+ *  - 独占锁先持有升级门，再独占锁定 std::shared_timed_mutex。
+ *
+ * 由于所有写者都必须先经过升级门，持有可升级锁期间数据不会被修改，升级为独占锁时只需等待现有读者退出。
+ */
+class UpgradeMutex {
+public:
+    UpgradeMutex() = default;
+    UpgradeMutex(const UpgradeMutex&) = delete;
+    UpgradeMutex& operator=(const UpgradeMutex&) = delete;
+
+    // 独占锁
+    void lock() {
+        gate_.lock();
+        rw_.lock();
+    }
+
+    bool try_lock() {
+        if (!gate_.try_lock()) {
+            return false;
+        }
+        if (!rw_.try_lock()) {
+            gate_.unlock();
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+        // 两步共用同一个截止时间，总等待不超过 timeout
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (!gate_.try_lock_until(deadline)) {
+            return false;
+        }
+        if (!rw_.try_lock_until(deadline)) {
+            gate_.unlock();
+            return false;
+        }
+        return true;
+    }
+
+    void unlock() {
+        rw_.unlock();
+        gate_.unlock();
+    }
+
+    // 共享锁
+    void lock_shared() {
+        rw_.lock_shared();
+    }
+
+    bool try_lock_shared() {
+        return rw_.try_lock_shared();
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout) {
+        return rw_.try_lock_shared_for(timeout);
+    }
+
+    void unlock_shared() {
+        rw_.unlock_shared();
+    }
+
+    // 可升级锁
+    void lock_upgrade() {
+        gate_.lock();
+    }
+
+    bool try_lock_upgrade() {
+        return gate_.try_lock();
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_upgrade_for(const std::chrono::duration<Rep, Period>& timeout) {
+        return gate_.try_lock_for(timeout);
+    }
+
+    void unlock_upgrade() {
+        gate_.unlock();
+    }
+
+    // 状态转换
+    void unlock_upgrade_and_lock() {
+        rw_.lock();
+    }
+
+    void unlock_upgrade_and_lock_shared() {
+        rw_.lock_shared();
+        gate_.unlock();
+    }
+
+    void unlock_and_lock_upgrade() {
+        rw_.unlock();
+    }
+
+    void unlock_and_lock_shared() {
+        // 仍持有升级门，其他写者无法在两步之间插入
+        rw_.unlock();
+        rw_.lock_shared();
+        gate_.unlock();
+    }
+
+private:
+    std::timed_mutex gate_;
+    std::shared_timed_mutex rw_;
+};
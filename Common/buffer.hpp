@@ -1,41 +1,41 @@
 #pragma once
 
+#include "ByteBuffer.hpp"
+#include "buffer_pool.hpp"
 #include "slice.hpp"
 
-#include <algorithm>
 #include <cassert>
-
+#include <string>
+
+// Buffer is the Go-style interface to glasssix::ByteBuffer; both share the same
+// storage engine (inline storage for small messages, ref-counted heap blocks).
+// Heap blocks come from glasssix::BufferPool::global(). Once the buffer drains,
+// its block goes back to the pool at the next write, so the slices returned by
+// Next stay valid until then and a buffer between messages holds no more than
+// its inline storage.
 class Buffer {
 public:
-    explicit Buffer(size_t initial_size = 1024, size_t reserved_prepend_size = 8)
-        : capacity_(reserved_prepend_size + initial_size)
-        , read_index_(reserved_prepend_size)
-        , write_index_(reserved_prepend_size)
-        , reserved_prepend_size_(reserved_prepend_size) {
-        buffer_ = new char[capacity_];
+    // The default initial size keeps the storage inline.
+    explicit Buffer(size_t initial_size = glasssix::ByteBuffer::InlineCapacity - 8, size_t reserved_prepend_size = 8)
+        : buffer_(initial_size, reserved_prepend_size) {
+        // Releasing on drain would free the storage under the slices returned by Next;
+        // defer it to the next write, which is where those slices expire anyway.
+        glasssix::PooledByteBuffer::ShrinkPolicy policy;
+        policy.release_before_write = true;
+        buffer_.set_shrink_policy(policy);
         assert(length() == 0);
-        assert(WritableBytes() == initial_size);
+        assert(WritableBytes() >= initial_size);
         assert(PrependableBytes() == reserved_prepend_size);
     }
 
-    ~Buffer() {
-        delete[] buffer_;
-        buffer_ = nullptr;
-        capacity_ = 0;
-    }
-
     void Swap(Buffer& rhs) {
-        std::swap(buffer_, rhs.buffer_);
-        std::swap(capacity_, rhs.capacity_);
-        std::swap(read_index_, rhs.read_index_);
-        std::swap(write_index_, rhs.write_index_);
-        std::swap(reserved_prepend_size_, rhs.reserved_prepend_size_);
+        buffer_.swap(rhs.buffer_);
     }
 
     // Skip advances the reading index of the buffer
     void Skip(size_t len) {
         if (len < length()) {
-            read_index_ += len;
+            buffer_.skip(len);
         } else {
             Reset();
         }
@@ -52,10 +52,9 @@ public:
     // It does nothing if n is greater than the length of the buffer.
     void Truncate(size_t n) {
         if (n == 0) {
-            read_index_ = reserved_prepend_size_;
-            write_index_ = reserved_prepend_size_;
-        } else if (write_index_ > read_index_ + n) {
-            write_index_ = read_index_ + n;
+            buffer_.skip_all();
+        } else if (length() > n) {
+            buffer_.unwrite(length() - n);
         }
     }
 
@@ -70,30 +69,20 @@ public:
     // or equal to len. If len is greater than the current capacity(),
     // new storage is allocated, otherwise the method does nothing.
     void Reserve(size_t len) {
-        if (capacity_ >= len + reserved_prepend_size_) {
-            return;
+        if (len > length()) {
+            buffer_.reserve(len - length());
         }
-
-        // TODO add the implementation logic here
-        grow(len + reserved_prepend_size_);
     }
 
     // Make sure there is enough memory space to append more data with length len
     void EnsureWritableBytes(size_t len) {
-        if (WritableBytes() < len) {
-            grow(len);
-        }
-
-        assert(WritableBytes() >= len);
+        buffer_.ensure_writable_bytes(len);
     }
 
     // Write
 public:
     void Write(const void* d, size_t len) {
-        EnsureWritableBytes(len);
-        memcpy(WriteBegin(), d, len);
-        assert(write_index_ + len <= capacity_);
-        write_index_ += len;
+        buffer_.append(d, len);
     }
 
     void Append(const Slice& str) {
@@ -110,20 +99,15 @@ public:
 
     // Insert content, specified by the parameter, into the front of reading index
     void Prepend(const void* d, size_t len) {
-        assert(len <= PrependableBytes());
-        read_index_ -= len;
-        const char* p = static_cast<const char*>(d);
-        memcpy(buffer_ + read_index_, p, len);
+        buffer_.prepend(d, len);
     }
 
     void UnwriteBytes(size_t n) {
-        assert(n <= length());
-        write_index_ -= n;
+        buffer_.unwrite(n);
     }
 
     void WriteBytes(size_t n) {
-        assert(n <= WritableBytes());
-        write_index_ += n;
+        buffer_.has_written(n);
     }
 
     //Read
@@ -136,10 +120,10 @@ public:
         return std::string(data(), length());
     }
 
+    // Shrink reallocates the storage to fit the unread bytes plus reserve.
+    // On an empty buffer Shrink(0) falls back to inline storage.
     void Shrink(size_t reserve) {
-        Buffer other(length() + reserve);
-        other.Append(ToSlice());
-        Swap(other);
+        buffer_.shrink(reserve);
     }
 
     // Next returns a slice containing the next n bytes from the buffer,
@@ -149,13 +133,19 @@ public:
     Slice Next(size_t len) {
         if (len < length()) {
             Slice result(data(), len);
-            read_index_ += len;
+            buffer_.skip(len);
             return result;
         }
 
         return NextAll();
     }
 
+    // NextShared is like Next, but the slice shares the buffer's storage and
+    // stays valid until the last copy of it is destroyed.
+    SharedSlice NextShared(size_t len) {
+        return buffer_.read_shared(len < length() ? len : length());
+    }
+
     // NextAll returns a slice containing all the unread portion of the buffer,
     // advancing the buffer as if the bytes had been returned by Read.
     Slice NextAll() {
@@ -165,13 +155,15 @@ public:
     }
 
     std::string NextString(size_t len) {
-        Slice s = Next(len);
-        return std::string(s.data(), s.size());
+        std::string result(data(), len < length() ? len : length());
+        Skip(len);
+        return result;
     }
 
     std::string NextAllString() {
-        Slice s = NextAll();
-        return std::string(s.data(), s.size());
+        std::string result = ToString();
+        Reset();
+        return result;
     }
 
     // ReadByte reads and returns the next byte from the buffer.
@@ -183,14 +175,15 @@ public:
             return '\0';
         }
 
-        return buffer_[read_index_++];
+        char c = *data();
+        buffer_.skip(1);
+        return c;
     }
 
     // UnreadBytes unreads the last n bytes returned
     // by the most recent read operation.
     void UnreadBytes(size_t n) {
-        assert(n < read_index_);
-        read_index_ -= n;
+        buffer_.unread(n);
     }
 
 public:
@@ -200,21 +193,20 @@ public:
     // The data aliases the buffer content at least until the next buffer modification,
     // so immediate changes to the slice will affect the result of future reads.
     const char* data() const {
-        return buffer_ + read_index_;
+        return buffer_.peek();
     }
 
     char* WriteBegin() {
-        return buffer_ + write_index_;
+        return buffer_.begin_write();
     }
 
     const char* WriteBegin() const {
-        return buffer_ + write_index_;
+        return buffer_.begin_write();
     }
 
     // length returns the number of bytes of the unread portion of the buffer
     size_t length() const {
-        assert(write_index_ >= read_index_);
-        return write_index_ - read_index_;
+        return buffer_.readable_bytes();
     }
 
     // size returns the number of bytes of the unread portion of the buffer.
@@ -226,48 +218,19 @@ public:
     // capacity returns the capacity of the buffer's underlying byte slice, that is, the
     // total space allocated for the buffer's data.
     size_t capacity() const {
-        return capacity_;
+        return buffer_.internal_capacity();
     }
 
     size_t WritableBytes() const {
-        assert(capacity_ >= write_index_);
-        return capacity_ - write_index_;
+        return buffer_.writable_bytes();
     }
 
     size_t PrependableBytes() const {
-        return read_index_;
+        return buffer_.prependable_bytes();
     }
 
-private:
-    void grow(size_t len) {
-        if (WritableBytes() + PrependableBytes() < len + reserved_prepend_size_) {
-            //grow the capacity
-            size_t n = (capacity_ << 1) + len;
-            size_t m = length();
-            char* d = new char[n];
-            memcpy(d + reserved_prepend_size_, buffer_ + read_index_, m);
-            write_index_ = m + reserved_prepend_size_;
-            read_index_ = reserved_prepend_size_;
-            capacity_ = n;
-            delete[] buffer_;
-            buffer_ = d;
-        } else {
-            // move readable data to the front, make space inside buffer
-            assert(reserved_prepend_size_ < read_index_);
-            size_t readable = length();
-            memmove(buffer_ + reserved_prepend_size_, buffer_ + read_index_, length());
-            read_index_ = reserved_prepend_size_;
-            write_index_ = read_index_ + readable;
-            assert(readable == length());
-            assert(WritableBytes() >= len);
-        }
-    }
+    static constexpr char kCRLF[] = "\r\n";
 
 private:
-    char* buffer_;
-    size_t capacity_;
-    size_t read_index_;
-    size_t write_index_;
-    size_t reserved_prepend_size_;
-    static const char kCRLF[];
+    glasssix::PooledByteBuffer buffer_;
 };
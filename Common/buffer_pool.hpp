@@ -0,0 +1,308 @@
+#pragma once
+
+#include "ByteBuffer.hpp"
+#include "SpinLock.hpp"
+#include "per_thread.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace glasssix {
+    struct BufferPoolStats {
+        size_t in_use_bytes;     // handed out and not returned yet
+        size_t high_water_bytes; // peak of in_use_bytes since construction or reset_high_water()
+        size_t cached_bytes;     // free blocks kept for reuse
+        size_t allocations;
+        size_t cache_hits;
+    };
+
+    /*!
+     * \class BufferPool
+     *
+     * \brief Size-class pool for buffer storage.
+     *
+     * Requests up to MaxBlockSize are rounded up to a power of two from
+     * MinBlockSize and served from a per-thread cache first, then from the
+     * shared free lists, then from operator new. Freed blocks go back to the
+     * freeing thread's cache; beyond LocalCacheBytes per size class they go
+     * to the shared lists, and beyond max_cached_bytes in total they are
+     * released to the system. When a thread exits its cached blocks move to
+     * the shared lists. Larger requests bypass the caches but are still
+     * counted.
+     *
+     * Every pool keeps its own in-use and high-water accounting. trim()
+     * releases every cached block, including those in other threads' caches,
+     * e.g. from a timer once load drops.
+     *
+     * A pool must outlive every block it handed out; global() is never
+     * destroyed for that reason.
+     */
+    class BufferPool {
+    public:
+        static constexpr size_t MinBlockSize = 2048;
+        static constexpr size_t ClassCount = 10;
+        static constexpr size_t MaxBlockSize = MinBlockSize << (ClassCount - 1);
+        static constexpr size_t LocalCacheBytes = 256 * 1024;
+        static constexpr size_t DefaultMaxCachedBytes = 64 * 1024 * 1024;
+
+        explicit BufferPool(size_t max_cached_bytes = DefaultMaxCachedBytes)
+            : max_cached_bytes_{max_cached_bytes}, caches_{[this](local_cache& cache) { flush(cache); }} {}
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        ~BufferPool() {
+            trim();
+        }
+
+        static BufferPool& global() {
+            static BufferPool* pool = new BufferPool();
+            return *pool;
+        }
+
+        // The number of bytes allocate(n) really provides.
+        static size_t good_size(size_t n) {
+            return n > MaxBlockSize ? n : MinBlockSize << class_of(n);
+        }
+
+        void* allocate(size_t n) {
+            const size_t size = good_size(n);
+            note_allocated(size);
+            if (size > MaxBlockSize) {
+                return ::operator new(size);
+            }
+            const size_t cls = class_of(size);
+            {
+                local_cache& cache = local();
+                std::lock_guard<SpinLock> lock(cache.lock);
+                if (void* p = cache.lists[cls].pop()) {
+                    return hit(size, p);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (void* p = shared_[cls].pop()) {
+                    return hit(size, p);
+                }
+            }
+            return ::operator new(size);
+        }
+
+        // n must be the size that was passed to allocate.
+        void deallocate(void* p, size_t n) noexcept {
+            const size_t size = good_size(n);
+            in_use_.fetch_sub(size, std::memory_order_relaxed);
+            if (size > MaxBlockSize) {
+                ::operator delete(p);
+                return;
+            }
+            const size_t cls = class_of(size);
+            {
+                local_cache& cache = local();
+                std::lock_guard<SpinLock> lock(cache.lock);
+                if (cache.lists[cls].count * size < LocalCacheBytes) {
+                    cache.lists[cls].push(p);
+                    cached_.fetch_add(size, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            if (cached_.load(std::memory_order_relaxed) + size <= max_cached_bytes_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                shared_[cls].push(p);
+                cached_.fetch_add(size, std::memory_order_relaxed);
+                return;
+            }
+            ::operator delete(p);
+        }
+
+        // Releases every cached block to the system; blocks in use are not affected.
+        void trim() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (size_t cls = 0; cls < ClassCount; ++cls) {
+                    release(shared_[cls], MinBlockSize << cls);
+                }
+            }
+            caches_.for_each([this](local_cache& cache) {
+                std::lock_guard<SpinLock> lock(cache.lock);
+                for (size_t cls = 0; cls < ClassCount; ++cls) {
+                    release(cache.lists[cls], MinBlockSize << cls);
+                }
+            });
+        }
+
+        void set_max_cached_bytes(size_t bytes) {
+            max_cached_bytes_.store(bytes, std::memory_order_relaxed);
+        }
+
+        BufferPoolStats stats() const {
+            BufferPoolStats s;
+            s.in_use_bytes = in_use_.load(std::memory_order_relaxed);
+            s.high_water_bytes = high_water_.load(std::memory_order_relaxed);
+            s.cached_bytes = cached_.load(std::memory_order_relaxed);
+            s.allocations = allocations_.load(std::memory_order_relaxed);
+            s.cache_hits = hits_.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        // Restarts the high-water mark from the current in-use bytes.
+        void reset_high_water() {
+            high_water_.store(in_use_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+    private:
+        struct free_list {
+            struct node {
+                node* next;
+            };
+
+            node* head{nullptr};
+            size_t count{0};
+
+            void push(void* p) {
+                node* n = static_cast<node*>(p);
+                n->next = head;
+                head = n;
+                ++count;
+            }
+
+            void* pop() {
+                node* n = head;
+                if (n != nullptr) {
+                    head = n->next;
+                    --count;
+                }
+                return n;
+            }
+        };
+
+        // Used by its own thread, and by trim() from any thread.
+        struct alignas(::detail::hardware_destructive_interference_size) local_cache {
+            SpinLock lock;
+            free_list lists[ClassCount];
+        };
+
+        // Index of the smallest class holding n bytes; n <= MaxBlockSize.
+        static size_t class_of(size_t n) {
+            size_t cls = 0;
+            while ((MinBlockSize << cls) < n) {
+                ++cls;
+            }
+            return cls;
+        }
+
+        void note_allocated(size_t size) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            const size_t in_use = in_use_.fetch_add(size, std::memory_order_relaxed) + size;
+            size_t peak = high_water_.load(std::memory_order_relaxed);
+            while (in_use > peak && !high_water_.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {
+            }
+        }
+
+        void* hit(size_t size, void* p) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            cached_.fetch_sub(size, std::memory_order_relaxed);
+            return p;
+        }
+
+        void release(free_list& list, size_t size) {
+            while (void* p = list.pop()) {
+                cached_.fetch_sub(size, std::memory_order_relaxed);
+                ::operator delete(p);
+            }
+        }
+
+        local_cache& local() {
+            return caches_.local([] { return std::make_unique<local_cache>(); });
+        }
+
+        // Hands an exiting thread's blocks to the shared lists; they stay counted in cached_.
+        void flush(local_cache& cache) {
+            std::lock_guard<SpinLock> cache_lock(cache.lock);
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t cls = 0; cls < ClassCount; ++cls) {
+                while (void* p = cache.lists[cls].pop()) {
+                    shared_[cls].push(p);
+                }
+            }
+        }
+
+        std::atomic<size_t> max_cached_bytes_;
+        std::atomic<size_t> in_use_{0};
+        std::atomic<size_t> high_water_{0};
+        std::atomic<size_t> cached_{0};
+        std::atomic<size_t> allocations_{0};
+        std::atomic<size_t> hits_{0};
+        std::mutex mutex_;
+        free_list shared_[ClassCount];
+        per_thread<local_cache> caches_;
+    };
+
+    /*!
+     * \brief Standard allocator over a BufferPool (the global one by default).
+     *
+     * good_size() lets BasicByteBuffer use the whole size class it was given.
+     */
+    template <typename T>
+    class PoolAllocator {
+    public:
+        using value_type = T;
+
+        PoolAllocator() noexcept : pool_{&BufferPool::global()} {}
+
+        explicit PoolAllocator(BufferPool& pool) noexcept : pool_{&pool} {}
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U>& other) noexcept : pool_{other.pool()} {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            pool_->deallocate(p, n * sizeof(T));
+        }
+
+        size_t good_size(size_t n) const {
+            return BufferPool::good_size(n * sizeof(T)) / sizeof(T);
+        }
+
+        BufferPool* pool() const noexcept {
+            return pool_;
+        }
+
+    private:
+        BufferPool* pool_;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+        return a.pool() == b.pool();
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+        return !(a == b);
+    }
+
+    /*!
+     * ByteBuffer whose heap blocks come from a BufferPool and go back to it
+     * when it drains or is destroyed; an idle one holds only inline storage.
+     */
+    class PooledByteBuffer : public BasicByteBuffer<PoolAllocator<char>> {
+    public:
+        explicit PooledByteBuffer(size_t size = InlineCapacity - CheapPrepend, size_t prepend_size = CheapPrepend,
+            BufferPool& pool = BufferPool::global())
+            : BasicByteBuffer(size, prepend_size, PoolAllocator<char>(pool)) {
+            ShrinkPolicy policy;
+            policy.release_on_drain = true;
+            set_shrink_policy(policy);
+        }
+    };
+} // namespace glasssix
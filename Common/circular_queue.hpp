@@ -1,24 +1,84 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
 #include <vector>
 
 /// <summary>
 /// Non-thread-safe cyclic queue based on std::vector.
 /// </summary>
 /// <typeparam name="T"></typeparam>
-template <typename T>
+/// <typeparam name="PowerOfTwo">
+/// false: exactly max_items slots, one extra slot marks "full" and indices wrap with a compare.
+/// true: max_items is rounded up to a power of two, head and tail are free-running 64-bit
+/// counters and a slot is found with a single AND, so at() and iteration never divide.
+/// </typeparam>
+template <typename T, bool PowerOfTwo = false>
 class circular_queue {
 public:
     using value_type = T;
 
+private:
+    using counter_type = std::conditional_t<PowerOfTwo, std::uint64_t, std::size_t>;
+
+public:
+    /// <summary>
+    /// A contiguous run of stored items, oldest first.
+    /// </summary>
+    struct span {
+        const T* data;
+        std::size_t size;
+
+        const T* begin() const { return data; }
+
+        const T* end() const { return data + size; }
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator(const circular_queue* queue, counter_type pos) : queue_{queue}, pos_{pos} {}
+
+        reference operator*() const { return queue_->slot(pos_); }
+
+        pointer operator->() const { return &queue_->slot(pos_); }
+
+        const_iterator& operator++() {
+            pos_ = queue_->next(pos_);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& rhs) const { return pos_ == rhs.pos_; }
+
+        bool operator!=(const const_iterator& rhs) const { return pos_ != rhs.pos_; }
+
+    private:
+        const circular_queue* queue_;
+        counter_type pos_;
+    };
+
     /// <summary>
     /// disabled queue with no elements allocated at all
     /// </summary>
     circular_queue() = delete;
 
     explicit circular_queue(std::size_t max_items)
-        : max_items_(max_items + 1)
+        : max_items_(PowerOfTwo ? round_up_pow2(max_items) : max_items + 1)
+        , mask_{PowerOfTwo ? max_items_ - 1 : 0}
         , head_{0} // Keep an item as a marker for the full vec_.
         , tail_{0}
         , overrun_counter_{0}
@@ -29,7 +89,14 @@ public:
     circular_queue(const circular_queue&) = default;
     circular_queue& operator=(const circular_queue&) = default;
 
-    circular_queue(circular_queue&& other) noexcept { copy_moveable(std::move(other)); }
+    circular_queue(circular_queue&& other) noexcept
+        : max_items_{0}
+        , mask_{0}
+        , head_{0}
+        , tail_{0}
+        , overrun_counter_{0} {
+        copy_moveable(std::move(other));
+    }
 
     circular_queue& operator=(circular_queue&& other) noexcept {
         copy_moveable(std::move(other));
@@ -41,14 +108,9 @@ public:
     /// </summary>
     /// <param name="item"></param>
     void push(const T& item) {
-        vec_[tail_] = item;
-        tail_ = (tail_ + 1) % max_items_;
-
-        if (tail_ == head_) // overrun last item if full
-        {
-            head_ = (head_ + 1) % max_items_;
-            ++overrun_counter_;
-        }
+        slot(tail_) = item;
+        tail_ = next(tail_);
+        overrun_if_full();
     }
 
     /// <summary>
@@ -56,36 +118,38 @@ public:
     /// </summary>
     /// <param name="item"></param>
     void push(T&& item) {
-        vec_[tail_] = std::move(item);
-        tail_ = (tail_ + 1) % max_items_;
-
-        if (tail_ == head_) // overrun last item if full
-        {
-            head_ = (head_ + 1) % max_items_;
-            ++overrun_counter_;
-        }
+        slot(tail_) = std::move(item);
+        tail_ = next(tail_);
+        overrun_if_full();
     }
 
     /// <summary>
     /// Return reference to the front item. If there are no elements in the container, the behavior is undefined.
     /// </summary>
     /// <returns>item</returns>
-    const T& front() const { return vec_[head_]; }
+    const T& front() const { return slot(head_); }
 
-    T& front() { return vec_[head_]; }
+    T& front() { return slot(head_); }
 
     /// <summary>
     /// Return number of elements actually stored.
     /// </summary>
     /// <returns></returns>
     size_t size() const {
-        if (tail_ >= head_) {
+        if constexpr (PowerOfTwo) {
+            return static_cast<size_t>(tail_ - head_);
+        } else if (tail_ >= head_) {
             return tail_ - head_;
         } else {
             return max_items_ - (head_ - tail_);
         }
     }
 
+    /// <summary>
+    /// Return the maximum number of elements stored before the oldest one is overrun.
+    /// </summary>
+    size_t capacity() const { return PowerOfTwo ? max_items_ : max_items_ - 1; }
+
     /// <summary>
     /// // Return const reference to item by index. Index is out of range 0…size()-1, the behavior is undefined.
     /// </summary>
@@ -93,21 +157,49 @@ public:
     /// <returns>item</returns>
     const T& at(size_t i) const {
         assert(i < size());
-        return vec_[(head_ + i) % max_items_];
+        if constexpr (PowerOfTwo) {
+            return vec_[(head_ + i) & mask_];
+        } else {
+            const size_t index = head_ + i;
+            return vec_[index >= max_items_ ? index - max_items_ : index];
+        }
     }
 
     /// <summary>
     /// Pop item from front. If there are no elements in the container, the behavior is undefined.
     /// </summary>
-    void pop() { head_ = (head_ + 1) % max_items_; }
+    void pop() { head_ = next(head_); }
 
     bool empty() const { return tail_ == head_; }
 
     bool full() const {
-        // head is ahead of the tail by 1
-        return ((tail_ + 1) % max_items_) == head_;
+        if constexpr (PowerOfTwo) {
+            return tail_ - head_ == max_items_;
+        } else {
+            // head is ahead of the tail by 1
+            return next(tail_) == head_;
+        }
+    }
+
+    const_iterator begin() const { return const_iterator(this, head_); }
+
+    const_iterator end() const { return const_iterator(this, tail_); }
+
+    /// <summary>
+    /// Items from front() up to the end of the storage. Together with second_span() it covers all items in order,
+    /// so batches can be processed with plain loops over contiguous memory.
+    /// </summary>
+    span first_span() const {
+        const size_t index = storage_index(head_);
+        const size_t n = size();
+        return span{vec_.data() + index, n < vec_.size() - index ? n : vec_.size() - index};
     }
 
+    /// <summary>
+    /// Items that wrapped around to the start of the storage; empty if none did.
+    /// </summary>
+    span second_span() const { return span{vec_.data(), size() - first_span().size}; }
+
     std::size_t overrun_counter() const { return overrun_counter_; }
 
     void clear() {
@@ -117,9 +209,50 @@ public:
     }
 
 private:
+    static std::size_t round_up_pow2(std::size_t n) {
+        std::size_t result = 1;
+        while (result < n) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    size_t storage_index(counter_type pos) const {
+        if constexpr (PowerOfTwo) {
+            return static_cast<size_t>(pos & mask_);
+        } else {
+            return pos;
+        }
+    }
+
+    counter_type next(counter_type pos) const {
+        if constexpr (PowerOfTwo) {
+            return pos + 1;
+        } else {
+            return pos + 1 == max_items_ ? 0 : pos + 1;
+        }
+    }
+
+    const T& slot(counter_type pos) const { return vec_[storage_index(pos)]; }
+
+    T& slot(counter_type pos) { return vec_[storage_index(pos)]; }
+
+    void overrun_if_full() {
+        if constexpr (PowerOfTwo) {
+            // overrun last item if full, without a branch
+            const bool overrun = tail_ - head_ > max_items_;
+            head_ += overrun;
+            overrun_counter_ += overrun;
+        } else if (tail_ == head_) { // overrun last item if full
+            head_ = next(head_);
+            ++overrun_counter_;
+        }
+    }
+
     // copy from other&& and reset it to disabled state
     void copy_moveable(circular_queue&& other) noexcept {
         max_items_ = other.max_items_;
+        mask_ = other.mask_;
         head_ = other.head_;
         tail_ = other.tail_;
         overrun_counter_ = other.overrun_counter_;
@@ -127,14 +260,22 @@ private:
 
         // put &&other in disabled, but valid state
         other.max_items_ = 0;
+        other.mask_ = 0;
         other.head_ = other.tail_ = 0;
         other.overrun_counter_ = 0;
     }
 
 private:
-    const std::size_t max_items_;
-    std::size_t head_;
-    std::size_t tail_;
+    std::size_t max_items_;
+    std::size_t mask_;
+    counter_type head_;
+    counter_type tail_;
     std::size_t overrun_counter_;
     std::vector<T> vec_;
 };
+
+/// <summary>
+/// circular_queue in power-of-two mode.
+/// </summary>
+template <typename T>
+using pow2_circular_queue = circular_queue<T, true>;
@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+/*!
+ Cheap low-resolution clocks for timestamps that only need millisecond
+ precision (log lines, trace records, coarse timeouts).
+
+ By default now() reads CLOCK_REALTIME_COARSE / CLOCK_MONOTONIC_COARSE on
+ Linux: a vDSO load of the kernel's last tick, a few nanoseconds, with the
+ kernel tick as resolution (1-4 ms). Elsewhere it falls back to the precise
+ clocks.
+
+ start_ticker(tick) instead runs a background thread that publishes both
+ clocks into atomics every tick; now() is then a single relaxed load and the
+ resolution is the chosen tick on every platform.
+
+   coarse_clock::start_ticker(std::chrono::milliseconds{1});
+   date_time::now_coarse();
+   basic_thread_trace<coarse_steady_clock> trace;
+   elapsed_timer<std::milli, coarse_steady_clock> timer;
+*/
+namespace detail {
+    class coarse_ticker {
+    public:
+        static coarse_ticker& instance() {
+            static coarse_ticker ticker;
+            return ticker;
+        }
+
+        ~coarse_ticker() {
+            stop();
+        }
+
+        // start() and stop() hold lifecycle_mutex_ throughout, join included, so a
+        // start() cannot slip in while stop() is waiting for the old thread.
+        void start(std::chrono::nanoseconds tick) {
+            std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+            std::lock_guard<std::mutex> lock(mutex_);
+            tick_ = tick;
+            publish();
+            if (!thread_.joinable()) {
+                stop_ = false;
+                thread_ = std::thread([this] { run(); });
+            }
+            running_.store(true, std::memory_order_release);
+        }
+
+        void stop() {
+            std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_.store(false, std::memory_order_release);
+                stop_ = true;
+            }
+            condition_.notify_one();
+            if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+                thread_.join();
+            }
+        }
+
+        bool running() const {
+            return running_.load(std::memory_order_acquire);
+        }
+
+        std::int64_t wall_ns() const {
+            return wall_ns_.load(std::memory_order_relaxed);
+        }
+
+        std::int64_t steady_ns() const {
+            return steady_ns_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        coarse_ticker() = default;
+
+        void publish() {
+            using namespace std::chrono;
+            wall_ns_.store(duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count(),
+                std::memory_order_relaxed);
+            steady_ns_.store(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(),
+                std::memory_order_relaxed);
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stop_) {
+                condition_.wait_for(lock, tick_);
+                publish();
+            }
+        }
+
+        std::mutex lifecycle_mutex_;
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::chrono::nanoseconds tick_{std::chrono::milliseconds{1}};
+        std::atomic<bool> running_{false};
+        std::atomic<std::int64_t> wall_ns_{0};
+        std::atomic<std::int64_t> steady_ns_{0};
+        bool stop_{false};
+        std::thread thread_;
+    };
+
+#if defined(__linux__)
+    inline std::int64_t read_coarse(clockid_t id) {
+        timespec ts{};
+        clock_gettime(id, &ts);
+        return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+#endif
+} // namespace detail
+
+/*!
+ Coarse wall clock; its time_point is std::chrono::system_clock::time_point,
+ so values can be handed straight to date_time.
+*/
+class coarse_clock {
+public:
+    using duration = std::chrono::system_clock::duration;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::system_clock::time_point;
+    static constexpr bool is_steady = false;
+
+    static time_point now() noexcept {
+        const detail::coarse_ticker& ticker = detail::coarse_ticker::instance();
+        if (ticker.running()) {
+            return time_point{std::chrono::duration_cast<duration>(std::chrono::nanoseconds{ticker.wall_ns()})};
+        }
+#if defined(CLOCK_REALTIME_COARSE)
+        return time_point{
+            std::chrono::duration_cast<duration>(std::chrono::nanoseconds{detail::read_coarse(CLOCK_REALTIME_COARSE)})};
+#else
+        return std::chrono::system_clock::now();
+#endif
+    }
+
+    /*!
+     Switches both coarse clocks to a background thread updating every tick.
+     Calling it again changes the tick.
+    */
+    static void start_ticker(std::chrono::nanoseconds tick = std::chrono::milliseconds{1}) {
+        detail::coarse_ticker::instance().start(tick);
+    }
+
+    // Goes back to the kernel coarse clocks.
+    static void stop_ticker() {
+        detail::coarse_ticker::instance().stop();
+    }
+};
+
+/*!
+ Coarse monotonic clock, for elapsed_timer, basic_rate or basic_thread_trace
+ when tick resolution is enough.
+*/
+class coarse_steady_clock {
+public:
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<coarse_steady_clock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+        const detail::coarse_ticker& ticker = detail::coarse_ticker::instance();
+        if (ticker.running()) {
+            return time_point{duration{ticker.steady_ns()}};
+        }
+#if defined(CLOCK_MONOTONIC_COARSE)
+        // The kernel clock can lag the last precise value a stopped ticker published.
+        const std::int64_t ns = detail::read_coarse(CLOCK_MONOTONIC_COARSE);
+        const std::int64_t published = ticker.steady_ns();
+        return time_point{duration{ns > published ? ns : published}};
+#else
+        return time_point{
+            std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+#endif
+    }
+};
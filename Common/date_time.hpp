@@ -1,6 +1,11 @@
 #pragma once
+#include "coarse_clock.hpp"
+#include "time_zone.hpp"
+
 #include <chrono>
 #include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 
@@ -15,7 +20,7 @@ namespace detail {
  repeat_count("ab");  // == 1
  repeat_count("aab"); // == 2
 */
-inline int repeat_count(std::string_view s) {
+constexpr int repeat_count(std::string_view s) {
     if (s.empty())
         return 0;
     const char c{s[0]};
@@ -24,21 +29,92 @@ inline int repeat_count(std::string_view s) {
     return static_cast<int>(j);
 }
 
-inline std::string to_string_width(int val, int width = -1) {
-    char buf[16]{};
-    switch (width) {
-        case 1: sprintf(buf, "%01d", val); return buf;
-        case 2: sprintf(buf, "%02d", val); return buf;
-        case 3: sprintf(buf, "%03d", val); return buf;
-        case 4: sprintf(buf, "%04d", val); return buf;
-        case 5: sprintf(buf, "%05d", val); return buf;
-        case 6: sprintf(buf, "%06d", val); return buf;
-        case 7: sprintf(buf, "%07d", val); return buf;
-        case 8: sprintf(buf, "%08d", val); return buf;
-        case 9: sprintf(buf, "%09d", val); return buf;
-        default: break;
-    }
-    return std::to_string(val);
+inline constexpr char kDigitPairs[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+
+inline char* write_2digits(char* out, unsigned v) {
+    out[0] = kDigitPairs[v * 2];
+    out[1] = kDigitPairs[v * 2 + 1];
+    return out + 2;
+}
+
+// Writes v (< 100) with one digit when it fits, otherwise two.
+inline char* write_1or2digits(char* out, unsigned v) {
+    if (v < 10) {
+        *out = static_cast<char>('0' + v);
+        return out + 1;
+    }
+    return write_2digits(out, v);
+}
+
+// Writes v zero-padded to at least width digits, like printf("%0*lld").
+inline char* write_padded(char* out, std::int64_t v, int width) {
+    if (v < 0) {
+        *out++ = '-';
+        --width;
+        v = -v;
+    }
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (; n < width; --width) {
+        *out++ = '0';
+    }
+    while (n > 0) {
+        *out++ = tmp[--n];
+    }
+    return out;
+}
+
+struct civil_time {
+    std::int64_t second{INT64_MIN}; // seconds since epoch the fields belong to
+    std::int64_t year{};
+    unsigned month{};
+    unsigned day{};
+    unsigned hour{};
+    unsigned minute{};
+    unsigned sec{};
+};
+
+/*!
+ Broken-down time of a second since epoch. Consecutive calls within the same
+ second (the common case when stamping log lines) are a single compare.
+*/
+inline const civil_time& civil_from_seconds(std::int64_t seconds) {
+    thread_local civil_time cache;
+    if (cache.second != seconds) {
+        std::int64_t days = seconds / 86400;
+        std::int64_t sod = seconds % 86400;
+        if (sod < 0) {
+            sod += 86400;
+            --days;
+        }
+        thread_local std::int64_t cached_days{INT64_MIN};
+        thread_local civil_time cached_date;
+        if (cached_days != days) {
+            civil_from_days(days, cached_date.year, cached_date.month, cached_date.day);
+            cached_days = days;
+        }
+        cache.year = cached_date.year;
+        cache.month = cached_date.month;
+        cache.day = cached_date.day;
+        cache.hour = static_cast<unsigned>(sod / 3600);
+        cache.minute = static_cast<unsigned>(sod / 60 % 60);
+        cache.sec = static_cast<unsigned>(sod % 60);
+        cache.second = seconds;
+    }
+    return cache;
 }
 } // namespace
 
@@ -67,15 +143,339 @@ enum class time_spec
 |    zzz     | The fractional part of the second, to millisecond precision, including trailing zeroes where applicable (000 to 999). |
 */
 
+/*!
+ A date_time format string compiled once into a token list, with the same
+ grammar as date_time::to_string (see the table above).
+
+   static constexpr date_format kLogFormat{"yyyy-MM-dd HH:mm:ss.zzz"};
+   char buf[kLogFormat.max_size()];
+   const size_t n = date_time::now().format_to(buf, kLogFormat) - buf;
+
+ Construction is constexpr, so a format declared constexpr is parsed at
+ compile time; a format with too many tokens or literal characters is then a
+ compile error (std::length_error at run time). Formatting never allocates:
+ the date fields are cached per thread and per second, and digits are copied
+ from a lookup table.
+*/
+class date_format {
+public:
+    static constexpr std::size_t kMaxTokens = 32;
+    static constexpr std::size_t kMaxLiteral = 64;
+
+    explicit constexpr date_format(std::string_view format) {
+        std::size_t i{};
+        while (i < format.size()) {
+            const char c{format[i]};
+            auto repeat{static_cast<std::size_t>(detail::repeat_count(format.substr(i)))};
+            switch (c) {
+                case 'y':
+                    if (repeat >= 4) {
+                        repeat = 4;
+                        add(kind::year4, 0, 11);
+                    } else if (repeat >= 2) {
+                        repeat = 2;
+                        add(kind::year2, 0, 3);
+                    } else {
+                        add_literal(c, 1);
+                    }
+                    break;
+                case 'M':
+                case 'd':
+                case 'H':
+                case 'm':
+                case 's':
+                    repeat = repeat >= 2 ? 2 : 1;
+                    add(c == 'M' ? kind::month
+                        : c == 'd' ? kind::day
+                        : c == 'H' ? kind::hour
+                        : c == 'm' ? kind::minute
+                                   : kind::second,
+                        static_cast<std::uint8_t>(repeat), 2);
+                    break;
+                case 'z':
+                    repeat = repeat >= 3 ? 3 : 1;
+                    add(repeat == 3 ? kind::msec : kind::msec_trimmed, 0, 3);
+                    break;
+                default: add_literal(c, repeat); break;
+            }
+            i += repeat;
+        }
+    }
+
+    // Upper bound of the bytes written by format_to.
+    constexpr std::size_t max_size() const {
+        return max_size_;
+    }
+
+    /*!
+     Formats ms milliseconds since epoch, already shifted to the wanted time
+     zone, into out, which must hold max_size() bytes. Returns the end of the
+     written text; no terminating zero is added.
+    */
+    char* format_to(char* out, std::int64_t ms) const {
+        std::int64_t seconds = ms / 1000;
+        std::int64_t millis = ms % 1000;
+        if (millis < 0) {
+            millis += 1000;
+            --seconds;
+        }
+        const detail::civil_time& t = detail::civil_from_seconds(seconds);
+        const auto msec = static_cast<unsigned>(millis);
+
+        for (std::size_t i = 0; i < token_count_; ++i) {
+            const token& tok = tokens_[i];
+            switch (tok.what) {
+                case kind::literal:
+                    for (std::size_t j = 0; j < tok.length; ++j) {
+                        out[j] = literal_[tok.offset + j];
+                    }
+                    out += tok.length;
+                    break;
+                case kind::year4:
+                    if (t.year >= 0 && t.year <= 9999) {
+                        out = detail::write_2digits(out, static_cast<unsigned>(t.year / 100));
+                        out = detail::write_2digits(out, static_cast<unsigned>(t.year % 100));
+                    } else {
+                        out = detail::write_padded(out, t.year, t.year < 0 ? 5 : 4);
+                    }
+                    break;
+                case kind::year2: out = detail::write_padded(out, t.year % 100, 2); break;
+                case kind::month: out = write_field(out, t.month, tok.width); break;
+                case kind::day: out = write_field(out, t.day, tok.width); break;
+                case kind::hour: out = write_field(out, t.hour, tok.width); break;
+                case kind::minute: out = write_field(out, t.minute, tok.width); break;
+                case kind::second: out = write_field(out, t.sec, tok.width); break;
+                case kind::msec:
+                    *out++ = static_cast<char>('0' + msec / 100);
+                    out = detail::write_2digits(out, msec % 100);
+                    break;
+                case kind::msec_trimmed:
+                    // Like the decimal part of the seconds: 200 -> "2", 20 -> "02", 2 -> "002".
+                    *out++ = static_cast<char>('0' + msec / 100);
+                    if (msec % 100 != 0) {
+                        *out++ = static_cast<char>('0' + msec / 10 % 10);
+                        if (msec % 10 != 0) {
+                            *out++ = static_cast<char>('0' + msec % 10);
+                        }
+                    }
+                    break;
+            }
+        }
+        return out;
+    }
+
+    std::string to_string(std::int64_t ms) const {
+        std::string result(max_size_, '\0');
+        result.resize(static_cast<std::size_t>(format_to(result.data(), ms) - result.data()));
+        return result;
+    }
+
+    /*!
+     Parses text laid out by this format into milliseconds since epoch, in the
+     same (unshifted) time as format_to takes. Fields absent from the format
+     default to 1970-01-01 00:00:00.000; "yy" years are read as 2000-2099.
+
+     Two-digit fields, "zzz" and literals are fixed width; their characters
+     are validated with a branch-free accumulated check and rejected once at
+     the end, so fixed layouts such as "yyyy-MM-dd HH:mm:ss.zzz" parse without
+     data-dependent branches. "yyyy" reads exactly four digits when another
+     numeric field follows, as in "yyyyMMdd"; at the end or before a literal
+     it also takes the extra digits of years past 9999.
+
+     @return false if text does not match the format or a field is out of range
+    */
+    constexpr bool parse(std::string_view text, std::int64_t& ms) const {
+        const char* p = text.data();
+        const char* const end = p + text.size();
+        unsigned bad = 0;
+        std::int64_t year = 1970;
+        unsigned month = 1, day = 1, hour = 0, minute = 0, second = 0, msec = 0;
+
+        for (std::size_t i = 0; i < token_count_; ++i) {
+            const token& tok = tokens_[i];
+            switch (tok.what) {
+                case kind::literal:
+                    if (static_cast<std::size_t>(end - p) < tok.length ||
+                        std::string_view{p, tok.length} != std::string_view{literal_ + tok.offset, tok.length}) {
+                        return false;
+                    }
+                    p += tok.length;
+                    break;
+                case kind::year4: {
+                    const bool negative = p < end && *p == '-';
+                    p += negative;
+                    if (end - p < 4) {
+                        return false;
+                    }
+                    year = fixed_digits(p, 4, bad);
+                    const bool last_number = i + 1 == token_count_ || tokens_[i + 1].what == kind::literal;
+                    while (last_number && p < end && is_digit(*p) && year < 100000000) {
+                        year = year * 10 + (*p++ - '0');
+                    }
+                    year = negative ? -year : year;
+                    break;
+                }
+                case kind::year2:
+                    if (end - p < 2) {
+                        return false;
+                    }
+                    year = 2000 + fixed_digits(p, 2, bad);
+                    break;
+                case kind::month:
+                case kind::day:
+                case kind::hour:
+                case kind::minute:
+                case kind::second: {
+                    unsigned v = 0;
+                    if (tok.width == 2) {
+                        if (end - p < 2) {
+                            return false;
+                        }
+                        v = fixed_digits(p, 2, bad);
+                    } else {
+                        if (p == end || !is_digit(*p)) {
+                            return false;
+                        }
+                        v = static_cast<unsigned>(*p++ - '0');
+                        if (p < end && is_digit(*p)) {
+                            v = v * 10 + static_cast<unsigned>(*p++ - '0');
+                        }
+                    }
+                    (tok.what == kind::month    ? month
+                        : tok.what == kind::day  ? day
+                        : tok.what == kind::hour ? hour
+                        : tok.what == kind::minute ? minute
+                                                 : second) = v;
+                    break;
+                }
+                case kind::msec:
+                    if (end - p < 3) {
+                        return false;
+                    }
+                    msec = fixed_digits(p, 3, bad);
+                    break;
+                case kind::msec_trimmed: {
+                    // Decimal part of the seconds: "2" -> 200, "02" -> 20.
+                    if (p == end || !is_digit(*p)) {
+                        return false;
+                    }
+                    unsigned scale = 100;
+                    msec = 0;
+                    for (int n = 0; n < 3 && p < end && is_digit(*p); ++n, scale /= 10) {
+                        msec += static_cast<unsigned>(*p++ - '0') * scale;
+                    }
+                    break;
+                }
+            }
+        }
+
+        bad |= static_cast<unsigned>(p != end);
+        bad |= static_cast<unsigned>(month - 1 > 11) | static_cast<unsigned>(hour > 23) |
+               static_cast<unsigned>(minute > 59) | static_cast<unsigned>(second > 59);
+        if (bad != 0) {
+            return false;
+        }
+        constexpr unsigned kMonthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        const unsigned month_days = kMonthDays[month - 1] + (month == 2 && detail::is_leap_year(year));
+        if (day - 1 >= month_days) {
+            return false;
+        }
+        ms = (detail::days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second) * 1000 + msec;
+        return true;
+    }
+
+private:
+    enum class kind : std::uint8_t { literal, year4, year2, month, day, hour, minute, second, msec, msec_trimmed };
+
+    struct token {
+        kind what{kind::literal};
+        std::uint8_t width{0};
+        std::uint16_t offset{0};
+        std::uint16_t length{0};
+    };
+
+    static constexpr bool is_digit(char c) {
+        return static_cast<unsigned>(c - '0') <= 9;
+    }
+
+    // Reads n characters as digits; a non-digit sets bad instead of branching.
+    static constexpr unsigned fixed_digits(const char*& p, int n, unsigned& bad) {
+        unsigned v = 0;
+        for (int i = 0; i < n; ++i) {
+            const auto digit = static_cast<unsigned>(p[i] - '0');
+            bad |= static_cast<unsigned>(digit > 9);
+            v = v * 10 + digit;
+        }
+        p += n;
+        return v;
+    }
+
+    static char* write_field(char* out, unsigned v, std::uint8_t width) {
+        return width == 2 ? detail::write_2digits(out, v) : detail::write_1or2digits(out, v);
+    }
+
+    constexpr void add(kind what, std::uint8_t width, std::size_t size) {
+        if (token_count_ == kMaxTokens) {
+            throw std::length_error("date_format: too many tokens");
+        }
+        tokens_[token_count_++] = token{what, width, 0, 0};
+        max_size_ += size;
+    }
+
+    constexpr void add_literal(char c, std::size_t repeat) {
+        if (literal_size_ + repeat > kMaxLiteral) {
+            throw std::length_error("date_format: literal text too long");
+        }
+        if (token_count_ == 0 || tokens_[token_count_ - 1].what != kind::literal) {
+            add(kind::literal, 0, 0);
+            tokens_[token_count_ - 1].offset = static_cast<std::uint16_t>(literal_size_);
+        }
+        for (std::size_t j = 0; j < repeat; ++j) {
+            literal_[literal_size_++] = c;
+        }
+        tokens_[token_count_ - 1].length += static_cast<std::uint16_t>(repeat);
+        max_size_ += repeat;
+    }
+
+    token tokens_[kMaxTokens]{};
+    char literal_[kMaxLiteral]{};
+    std::size_t token_count_{0};
+    std::size_t literal_size_{0};
+    std::size_t max_size_{0};
+};
+
+namespace detail {
+constexpr bool parses_to(std::string_view format, std::string_view text, std::int64_t ms) {
+    std::int64_t parsed = -1;
+    return date_format{format}.parse(text, parsed) && parsed == ms;
+}
+} // namespace detail
+
+// Compact layouts must read back what to_string writes.
+static_assert(detail::parses_to("yyyyMMdd", "20261019", 1792368000000));
+static_assert(detail::parses_to("yyyyMMddHHmmss", "20261019123000", 1792413000000));
+static_assert(detail::parses_to("yyyyMMddHHmmsszzz", "20261019123000005", 1792413000005));
+static_assert(detail::parses_to("yyyy-MM-dd HH:mm:ss.zzz", "2026-10-19 12:30:00.005", 1792413000005));
+static_assert(!detail::parses_to("yyyyMMdd", "202610190", 1792368000000));
+
 class date_time {
 public:
     date_time()
         : timestamp_{} {}
 
+    /*!
+     With time_spec::local, timestamp holds a wall-clock time of
+     time_zone::current() and is converted to UTC.
+    */
     explicit date_time(std::chrono::system_clock::time_point timestamp, time_spec spec = time_spec::utc)
+        : date_time(timestamp, spec == time_spec::local ? time_zone::current() : nullptr) {}
+
+    // timestamp holds a wall-clock time of zone; nullptr means UTC.
+    date_time(std::chrono::system_clock::time_point timestamp, const time_zone* zone)
         : timestamp_{timestamp} {
-        if (spec == time_spec::local) {
-            timestamp_ -= std::chrono::hours{8};
+        if (zone != nullptr) {
+            const auto local = std::chrono::floor<std::chrono::seconds>(timestamp.time_since_epoch());
+            timestamp_ += std::chrono::seconds{zone->to_utc(local.count())} - local;
         }
     }
 
@@ -111,131 +511,101 @@ public:
     }
 
     std::string to_string(std::string_view format, time_spec spec = time_spec::local) const {
-        std::string result;
-        result.reserve(24);
+        return to_string(date_format{format}, spec);
+    }
 
-        date_time dt = *this;
-        if (spec == time_spec::local) {
-            dt.timestamp_ += std::chrono::hours{8};
-        }
-#if __cplusplus >= 202002L
-        const auto ymd{dt.date()};
-        const auto hms{dt.time()};
-
-        const auto year{static_cast<int>(ymd.year())};
-        const auto month{static_cast<unsigned int>(ymd.month())};
-        const auto day{static_cast<unsigned int>(ymd.day())};
-        const auto hour{static_cast<unsigned int>(hms.hours().count())};
-        const auto minute{static_cast<unsigned int>(hms.minutes().count())};
-        const auto second{static_cast<unsigned int>(hms.seconds().count())};
-#else
-        const std::time_t tt = std::chrono::system_clock::to_time_t(dt.timestamp_);
-        const std::tm* tm = gmtime(&tt);
-
-        const int year{tm->tm_year + 1900};
-        const int month{tm->tm_mon + 1};
-        const int day{tm->tm_mday};
-        const int hour = tm->tm_hour;
-        const int minute = tm->tm_min;
-        const int second = tm->tm_sec;
-#endif
+    std::string to_string(const date_format& format, time_spec spec = time_spec::local) const {
+        return format.to_string(shifted_ms(zone_of(spec)));
+    }
 
-        int i{};
-        while (i < format.size()) {
-            const char c{format[i]};
-            int repeat{detail::repeat_count(format.substr(i))};
+    // Formats the time as seen in zone; nullptr means UTC.
+    std::string to_string(std::string_view format, const time_zone* zone) const {
+        return to_string(date_format{format}, zone);
+    }
 
-            switch (c) {
-                case 'y':
-                    if (repeat >= 4) {
-                        repeat = 4;
-                        const int len = (year < 0) ? 5 : 4;
-                        result.append(detail::to_string_width(year, len));
-                    } else if (repeat >= 2) {
-                        repeat = 2;
-                        result.append(detail::to_string_width(year % 100, 2));
-                    } else {
-                        repeat = 1;
-                        result.push_back(c);
-                    }
-                    break;
-                case 'M':
-                    repeat = std::min(repeat, 2);
-                    switch (repeat) {
-                        case 1: result.append(detail::to_string_width(month)); break;
-                        case 2: result.append(detail::to_string_width(month, 2)); break;
-                        default: break;
-                    }
-                    break;
-                case 'd':
-                    repeat = std::min(repeat, 2);
-                    switch (repeat) {
-                        case 1: result.append(detail::to_string_width(day)); break;
-                        case 2: result.append(detail::to_string_width(day, 2)); break;
-                        default: break;
-                    }
-                    break;
-                case 'H':
-                    repeat = std::min(repeat, 2);
-                    switch (repeat) {
-                        case 1: result.append(detail::to_string_width(hour)); break;
-                        case 2: result.append(detail::to_string_width(hour, 2)); break;
-                        default: break;
-                    }
-                    break;
-                case 'm':
-                    repeat = std::min(repeat, 2);
-                    switch (repeat) {
-                        case 1: result.append(detail::to_string_width(minute)); break;
-                        case 2: result.append(detail::to_string_width(minute, 2)); break;
-                        default: break;
-                    }
-                    break;
-                case 's':
-                    repeat = std::min(repeat, 2);
-                    switch (repeat) {
-                        case 1: result.append(detail::to_string_width(second)); break;
-                        case 2: result.append(detail::to_string_width(second, 2)); break;
-                        default: break;
-                    }
-                    break;
-                case 'z':
-                    {
-                    repeat = (repeat >= 3) ? 3 : 1;
-                    // note: the millisecond component is treated like the
-                    // decimal part of the seconds so ms == 2 is always
-                    // printed as "002", but ms == 200 can be either "2" or
-                    // "200"
-#if __cplusplus >= 202002L
-                    const int ms =
-                        std::chrono::duration_cast<std::chrono::milliseconds>(hms.subseconds()).count();
-#else
-                    const int ms = dt.millisecond();
-#endif
-                    result.append(detail::to_string_width(ms, 3));
-                    if (repeat == 1) {
-                        if (result.back() == '0')
-                            result.pop_back();
-                        if (result.back() == '0')
-                            result.pop_back();
-                    }
-                    break;
-                    }
-                default: result.append(std::string(repeat, c)); break;
-            }
-            i += repeat;
+    std::string to_string(const date_format& format, const time_zone* zone) const {
+        return format.to_string(shifted_ms(zone));
+    }
+
+    /*!
+     Writes the formatted time into out, which must hold format.max_size()
+     bytes, and returns the end of the written text.
+    */
+    char* format_to(char* out, const date_format& format, time_spec spec = time_spec::local) const {
+        return format.format_to(out, shifted_ms(zone_of(spec)));
+    }
+
+    char* format_to(char* out, const date_format& format, const time_zone* zone) const {
+        return format.format_to(out, shifted_ms(zone));
+    }
+
+    /*!
+     Parses text with the date_format grammar; the result is the inverse of
+     to_string(format, spec).
+     @return std::nullopt if text does not match format
+    */
+    static std::optional<date_time> parse(
+        std::string_view text, const date_format& format, time_spec spec = time_spec::local) {
+        return parse(text, format, zone_of(spec));
+    }
+
+    static std::optional<date_time> parse(std::string_view text, std::string_view format, time_spec spec = time_spec::local) {
+        return parse(text, date_format{format}, zone_of(spec));
+    }
+
+    // text is a wall-clock time of zone; nullptr means UTC.
+    static std::optional<date_time> parse(std::string_view text, const date_format& format, const time_zone* zone) {
+        std::int64_t ms;
+        if (!format.parse(text, ms)) {
+            return std::nullopt;
         }
+        return date_time{std::chrono::system_clock::time_point{std::chrono::milliseconds{ms}}, zone};
+    }
 
-        return result;
+    /*!
+     Parses count strings from texts into out. Entries that fail to parse are
+     set to date_time{} (the epoch).
+     @return number of strings that failed to parse
+    */
+    static std::size_t parse(const std::string_view* texts, std::size_t count, date_time* out, const date_format& format,
+        time_spec spec = time_spec::local) {
+        const time_zone* zone = zone_of(spec);
+        std::size_t failed = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::int64_t ms;
+            if (format.parse(texts[i], ms)) {
+                out[i] = date_time{std::chrono::system_clock::time_point{std::chrono::milliseconds{ms}}, zone};
+            } else {
+                out[i] = date_time{};
+                ++failed;
+            }
+        }
+        return failed;
     }
 
     static date_time now() { return date_time{std::chrono::system_clock::now()}; }
 
+    // Like now() with tick resolution (see coarse_clock), for high-rate logging.
+    static date_time now_coarse() { return date_time{coarse_clock::now()}; }
+
     template <typename T = std::chrono::milliseconds>
     static date_time from_since_epoch(std::int64_t msecs) {
         return date_time{std::chrono::system_clock::time_point{T{msecs}}};
     }
 
 private:
+    static const time_zone* zone_of(time_spec spec) {
+        return spec == time_spec::local ? time_zone::current() : nullptr;
+    }
+
+    std::int64_t shifted_ms(const time_zone* zone) const {
+        const std::int64_t ms = to_since_epoch<std::chrono::milliseconds>();
+        if (zone == nullptr) {
+            return ms;
+        }
+        const std::int64_t seconds = ms / 1000 - (ms % 1000 < 0);
+        return ms + std::int64_t{zone->offset(seconds)} * 1000;
+    }
+
     std::chrono::system_clock::time_point timestamp_;
 };
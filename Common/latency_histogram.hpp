@@ -0,0 +1,407 @@
+#pragma once
+#include "per_thread.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*!
+ HDR-style latency histogram with log-linear buckets.
+
+ Values are grouped by power of two, and every power of two is split into
+ 2^sub_bucket_bits linear sub-buckets, so any recorded value is kept with a
+ relative error below 2^-sub_bucket_bits (5 bits: ~3%, 7 bits: ~0.8%).
+ Values above highest_value are counted in the last bucket; min() and max()
+ are always exact.
+
+ record() is lock-free and may be called from any number of threads.
+ record_exclusive() is cheaper (no locked RMW) but requires a single writer;
+ concurrent readers are still safe. Histograms with the same configuration
+ can be merged, and encode()/decode() give a compact binary form for shipping
+ them between processes.
+
+   hdr_histogram h;
+   {
+       scoped_latency<> guard{h};
+       handle_request();
+   }
+   h.value_at_percentile(0.99);
+*/
+class hdr_histogram {
+public:
+    explicit hdr_histogram(int sub_bucket_bits = 5, std::uint64_t highest_value = UINT64_MAX)
+        : sub_bits_{sub_bucket_bits}, highest_{highest_value} {
+        if (sub_bucket_bits < 1 || sub_bucket_bits > 16) {
+            throw std::invalid_argument("hdr_histogram: sub_bucket_bits must be in [1, 16]");
+        }
+        bucket_count_ = static_cast<size_t>(index_of(highest_value)) + 1;
+        counts_.reset(new std::atomic<std::uint64_t>[bucket_count_]);
+        reset();
+    }
+
+    hdr_histogram(const hdr_histogram& other) : hdr_histogram(other.sub_bits_, other.highest_) {
+        merge(other);
+    }
+
+    hdr_histogram& operator=(const hdr_histogram& other) {
+        if (this != &other) {
+            hdr_histogram tmp{other};
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    hdr_histogram(hdr_histogram&& other) noexcept
+        : sub_bits_{other.sub_bits_}, highest_{other.highest_}, bucket_count_{other.bucket_count_},
+          counts_{std::move(other.counts_)}, total_{other.total_.load(std::memory_order_relaxed)},
+          sum_{other.sum_.load(std::memory_order_relaxed)}, min_{other.min_.load(std::memory_order_relaxed)},
+          max_{other.max_.load(std::memory_order_relaxed)} {
+        other.bucket_count_ = 0;
+    }
+
+    hdr_histogram& operator=(hdr_histogram&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(hdr_histogram& other) noexcept {
+        std::swap(sub_bits_, other.sub_bits_);
+        std::swap(highest_, other.highest_);
+        std::swap(bucket_count_, other.bucket_count_);
+        counts_.swap(other.counts_);
+        swap_atomic(total_, other.total_);
+        swap_atomic(sum_, other.sum_);
+        swap_atomic(min_, other.min_);
+        swap_atomic(max_, other.max_);
+    }
+
+    // Lock-free, safe with concurrent writers.
+    void record(std::uint64_t value, std::uint64_t count = 1) {
+        counts_[index_clamped(value)].fetch_add(count, std::memory_order_relaxed);
+        total_.fetch_add(count, std::memory_order_relaxed);
+        sum_.fetch_add(value * count, std::memory_order_relaxed);
+        update_min(value);
+        update_max(value);
+    }
+
+    // Single writer only.
+    void record_exclusive(std::uint64_t value, std::uint64_t count = 1) {
+        add_exclusive(counts_[index_clamped(value)], count);
+        add_exclusive(total_, count);
+        add_exclusive(sum_, value * count);
+        if (value < min_.load(std::memory_order_relaxed)) {
+            min_.store(value, std::memory_order_relaxed);
+        }
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> d) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<std::uint64_t>(std::max<decltype(ns)>(ns, 0)));
+    }
+
+    // Records the time elapsed since timer was (re)started, in nanoseconds.
+    template <typename Clock>
+    void record_elapsed(elapsed_timer<std::nano, Clock>& timer) {
+        record(static_cast<std::uint64_t>(std::max(timer.elapsed(), 0.0)));
+    }
+
+    void merge(const hdr_histogram& other) {
+        if (other.sub_bits_ != sub_bits_ || other.highest_ != highest_) {
+            throw std::invalid_argument("hdr_histogram: merging histograms with different configuration");
+        }
+        for (size_t i = 0; i < bucket_count_; ++i) {
+            if (const std::uint64_t c = other.counts_[i].load(std::memory_order_relaxed)) {
+                counts_[i].fetch_add(c, std::memory_order_relaxed);
+            }
+        }
+        total_.fetch_add(other.total_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        update_min(other.min_.load(std::memory_order_relaxed));
+        update_max(other.max_.load(std::memory_order_relaxed));
+    }
+
+    void reset() {
+        for (size_t i = 0; i < bucket_count_; ++i) {
+            counts_[i].store(0, std::memory_order_relaxed);
+        }
+        total_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t min() const {
+        return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    double mean() const {
+        const std::uint64_t n = count();
+        return n == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / static_cast<double>(n);
+    }
+
+    /*!
+     Smallest recorded value v such that a fraction q (0..1) of the values are
+     <= v, reported as the upper bound of its bucket and clamped to max().
+    */
+    std::uint64_t value_at_percentile(double q) const {
+        const std::uint64_t n = count();
+        if (n == 0) {
+            return 0;
+        }
+        q = std::min(std::max(q, 0.0), 1.0);
+        const auto rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(q * static_cast<double>(n) + 0.5), 1);
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count_; ++i) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::max(std::min(upper_bound(static_cast<int>(i)), max()), min());
+            }
+        }
+        return max();
+    }
+
+    std::uint64_t p50() const {
+        return value_at_percentile(0.5);
+    }
+
+    std::uint64_t p99() const {
+        return value_at_percentile(0.99);
+    }
+
+    std::uint64_t p999() const {
+        return value_at_percentile(0.999);
+    }
+
+    int sub_bucket_bits() const {
+        return sub_bits_;
+    }
+
+    std::uint64_t highest_value() const {
+        return highest_;
+    }
+
+    /*!
+     Compact binary encoding, LEB128 varints throughout:
+       "HH" u8 version  u8 sub_bucket_bits  highest_value  min  max  sum
+       then for every non-empty bucket: index delta from the previous one, count
+    */
+    std::string encode() const {
+        std::string out{"HH"};
+        out.push_back(static_cast<char>(kVersion));
+        out.push_back(static_cast<char>(sub_bits_));
+        put_varint(out, highest_);
+        put_varint(out, min_.load(std::memory_order_relaxed));
+        put_varint(out, max());
+        put_varint(out, sum_.load(std::memory_order_relaxed));
+        size_t previous = 0;
+        for (size_t i = 0; i < bucket_count_; ++i) {
+            if (const std::uint64_t c = counts_[i].load(std::memory_order_relaxed)) {
+                put_varint(out, i - previous);
+                put_varint(out, c);
+                previous = i;
+            }
+        }
+        return out;
+    }
+
+    static hdr_histogram decode(std::string_view data) {
+        if (data.size() < 4 || data[0] != 'H' || data[1] != 'H' || static_cast<unsigned char>(data[2]) != kVersion) {
+            throw std::runtime_error("hdr_histogram: bad encoding header");
+        }
+        size_t pos = 4;
+        hdr_histogram h{static_cast<unsigned char>(data[3]), get_varint(data, pos)};
+        const std::uint64_t min_value = get_varint(data, pos);
+        const std::uint64_t max_value = get_varint(data, pos);
+        const std::uint64_t sum = get_varint(data, pos);
+        size_t index = 0;
+        std::uint64_t total = 0;
+        while (pos < data.size()) {
+            index += static_cast<size_t>(get_varint(data, pos));
+            const std::uint64_t c = get_varint(data, pos);
+            if (index >= h.bucket_count_) {
+                throw std::runtime_error("hdr_histogram: bucket index out of range");
+            }
+            h.counts_[index].store(c, std::memory_order_relaxed);
+            total += c;
+        }
+        h.total_.store(total, std::memory_order_relaxed);
+        h.sum_.store(sum, std::memory_order_relaxed);
+        h.min_.store(min_value, std::memory_order_relaxed);
+        h.max_.store(max_value, std::memory_order_relaxed);
+        return h;
+    }
+
+private:
+    static constexpr unsigned char kVersion = 1;
+
+    int index_of(std::uint64_t value) const {
+        const std::uint64_t sub_buckets = std::uint64_t{1} << sub_bits_;
+        if (value < sub_buckets) {
+            return static_cast<int>(value);
+        }
+        const int msb = 63 - count_leading_zeros(value);
+        const int shift = msb - sub_bits_;
+        return (shift + 1) * static_cast<int>(sub_buckets) + static_cast<int>((value >> shift) & (sub_buckets - 1));
+    }
+
+    size_t index_clamped(std::uint64_t value) const {
+        return value >= highest_ ? bucket_count_ - 1 : static_cast<size_t>(index_of(value));
+    }
+
+    std::uint64_t upper_bound(int i) const {
+        const int sub_buckets = 1 << sub_bits_;
+        if (i < sub_buckets) {
+            return static_cast<std::uint64_t>(i);
+        }
+        const int shift = i / sub_buckets - 1;
+        const std::uint64_t base = static_cast<std::uint64_t>(sub_buckets + i % sub_buckets) << shift;
+        return base + ((std::uint64_t{1} << shift) - 1);
+    }
+
+    static int count_leading_zeros(std::uint64_t v) {
+#if defined(__GNUC__)
+        return __builtin_clzll(v);
+#else
+        int n = 0;
+        for (std::uint64_t bit = std::uint64_t{1} << 63; !(v & bit); bit >>= 1) {
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+    static void add_exclusive(std::atomic<std::uint64_t>& a, std::uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void swap_atomic(std::atomic<std::uint64_t>& a, std::atomic<std::uint64_t>& b) {
+        const std::uint64_t tmp = a.load(std::memory_order_relaxed);
+        a.store(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        b.store(tmp, std::memory_order_relaxed);
+    }
+
+    void update_min(std::uint64_t value) {
+        std::uint64_t current = min_.load(std::memory_order_relaxed);
+        while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    void update_max(std::uint64_t value) {
+        std::uint64_t current = max_.load(std::memory_order_relaxed);
+        while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    static void put_varint(std::string& out, std::uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    static std::uint64_t get_varint(std::string_view data, size_t& pos) {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) {
+                throw std::runtime_error("hdr_histogram: truncated encoding");
+            }
+            const auto byte = static_cast<unsigned char>(data[pos++]);
+            v |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return v;
+            }
+        }
+        throw std::runtime_error("hdr_histogram: malformed varint");
+    }
+
+    int sub_bits_;
+    std::uint64_t highest_;
+    size_t bucket_count_{0};
+    std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+    std::atomic<std::uint64_t> total_{0};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> min_{UINT64_MAX};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+/*!
+ hdr_histogram split into one shard per recording thread.
+
+ Each thread records into its own shard with record_exclusive(), so hot paths
+ never share a cache line; snapshot() merges all shards into a single
+ histogram for queries. A finished thread's shard keeps its counts and is
+ reused by the next new thread.
+*/
+class sharded_histogram {
+public:
+    explicit sharded_histogram(int sub_bucket_bits = 5, std::uint64_t highest_value = UINT64_MAX)
+        : sub_bits_{sub_bucket_bits}, highest_{highest_value} {}
+
+    sharded_histogram(const sharded_histogram&) = delete;
+    sharded_histogram& operator=(const sharded_histogram&) = delete;
+
+    void record(std::uint64_t value, std::uint64_t count = 1) {
+        local_shard().record_exclusive(value, count);
+    }
+
+    template <typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> d) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<std::uint64_t>(std::max<decltype(ns)>(ns, 0)));
+    }
+
+    hdr_histogram snapshot() const {
+        hdr_histogram result{sub_bits_, highest_};
+        shards_.for_each([&](const hdr_histogram& shard) { result.merge(shard); });
+        return result;
+    }
+
+    // Racing updates on other threads may survive a reset.
+    void reset() {
+        shards_.for_each([](hdr_histogram& shard) { shard.reset(); });
+    }
+
+private:
+    hdr_histogram& local_shard() {
+        return shards_.local([this] { return std::make_unique<hdr_histogram>(sub_bits_, highest_); });
+    }
+
+    const int sub_bits_;
+    const std::uint64_t highest_;
+    per_thread<hdr_histogram> shards_;
+};
+
+/*!
+ Records the lifetime of the guard, in nanoseconds, into a histogram.
+*/
+template <typename Clock = std::chrono::steady_clock, typename Histogram = hdr_histogram>
+class scoped_latency {
+public:
+    explicit scoped_latency(Histogram& histogram) : histogram_{histogram} {}
+    ~scoped_latency() { histogram_.record(static_cast<std::uint64_t>(std::max(timer_.elapsed(), 0.0))); }
+    scoped_latency(const scoped_latency&) = delete;
+    scoped_latency& operator=(const scoped_latency&) = delete;
+
+private:
+    Histogram& histogram_;
+    elapsed_timer<std::nano, Clock> timer_;
+};
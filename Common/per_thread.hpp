@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace detail {
+    // Type-erased half of per_thread<T>: the live-owner registry and each thread's {owner id, state} list.
+    class per_thread_base {
+    public:
+        per_thread_base(const per_thread_base&) = delete;
+        per_thread_base& operator=(const per_thread_base&) = delete;
+
+    protected:
+        struct entry {
+            uint64_t owner;
+            void* state;
+        };
+
+        per_thread_base() : id_{next_id()} {}
+
+        ~per_thread_base() = default;
+
+        // Called by the derived constructor once it can receive thread_exit().
+        void attach() {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry().emplace(id_, this);
+        }
+
+        // Called first thing by the derived destructor; waits for thread exits in progress.
+        void detach() {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry().erase(id_);
+        }
+
+        // The exiting thread's state for this owner; runs with the registry locked, so the owner stays alive.
+        virtual void thread_exit(void* state) noexcept = 0;
+
+        // This thread's entry for this owner, or nullptr.
+        void* find() const {
+            for (const entry& e : entries().list) {
+                if (e.owner == id_) {
+                    return e.state;
+                }
+            }
+            return nullptr;
+        }
+
+        // Drops entries of destroyed owners, then records state for this one.
+        void add(void* state) {
+            std::vector<entry>& list = entries().list;
+            {
+                std::lock_guard<std::mutex> lock(registry_mutex());
+                list.erase(std::remove_if(list.begin(), list.end(),
+                                          [](const entry& e) { return registry().count(e.owner) == 0; }),
+                           list.end());
+            }
+            list.push_back({id_, state});
+        }
+
+        // Ids are never reused, so a cached entry of a destroyed owner never matches.
+        const uint64_t id_;
+
+    private:
+        struct thread_entries {
+            std::vector<entry> list;
+
+            ~thread_entries() {
+                std::lock_guard<std::mutex> lock(registry_mutex());
+                for (const entry& e : list) {
+                    auto it = registry().find(e.owner);
+                    if (it != registry().end()) {
+                        it->second->thread_exit(e.state);
+                    }
+                }
+            }
+        };
+
+        static thread_entries& entries() {
+            thread_local thread_entries t;
+            return t;
+        }
+
+        static uint64_t next_id() {
+            static std::atomic<uint64_t> id{1};
+            return id.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Never destroyed: threads may exit after static destructors have run.
+        static std::mutex& registry_mutex() {
+            static std::mutex* mutex = new std::mutex();
+            return *mutex;
+        }
+
+        static std::unordered_map<uint64_t, per_thread_base*>& registry() {
+            static auto* owners = new std::unordered_map<uint64_t, per_thread_base*>();
+            return *owners;
+        }
+    };
+} // namespace detail
+
+/*!
+ One T per thread that uses the owning object.
+
+ local() returns the calling thread's state, looked up through a per-thread
+ cache whose entries for destroyed owners are dropped on the next miss. When
+ a thread exits its state goes idle: it stays visible to for_each() and is
+ handed to the next thread that calls local(), so the number of states is
+ bounded by the peak number of concurrent threads rather than by thread churn.
+ All states are freed with the owner.
+*/
+template <typename T>
+class per_thread final : public detail::per_thread_base {
+public:
+    // on_exit runs on the exiting thread, under the lock for_each() takes, before its state goes idle.
+    explicit per_thread(std::function<void(T&)> on_exit = {}) : on_exit_{std::move(on_exit)} {
+        attach();
+    }
+
+    ~per_thread() {
+        detach();
+    }
+
+    // make() creates a state; reuse(T&) adapts an idle one for the calling thread.
+    template <typename Make, typename Reuse>
+    T& local(Make&& make, Reuse&& reuse) {
+        thread_local entry last{0, nullptr};
+        if (last.owner == id_) {
+            return *static_cast<T*>(last.state);
+        }
+        T* state = static_cast<T*>(find());
+        if (state == nullptr) {
+            state = acquire(std::forward<Make>(make), std::forward<Reuse>(reuse));
+            add(state);
+        }
+        last = entry{id_, state};
+        return *state;
+    }
+
+    template <typename Make>
+    T& local(Make&& make) {
+        return local(std::forward<Make>(make), [](T&) {});
+    }
+
+    // Visits every state, including idle ones, with thread exits held off.
+    template <typename F>
+    void for_each(F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& state : states_) {
+            f(*state);
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return states_.size();
+    }
+
+private:
+    template <typename Make, typename Reuse>
+    T* acquire(Make&& make, Reuse&& reuse) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                T* state = idle_.back();
+                idle_.pop_back();
+                reuse(*state);
+                return state;
+            }
+        }
+        std::unique_ptr<T> created = make();
+        T* state = created.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        states_.push_back(std::move(created));
+        // thread_exit() must not allocate.
+        idle_.reserve(states_.size());
+        return state;
+    }
+
+    void thread_exit(void* state) noexcept override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (on_exit_) {
+            on_exit_(*static_cast<T*>(state));
+        }
+        idle_.push_back(static_cast<T*>(state));
+    }
+
+    const std::function<void(T&)> on_exit_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<T>> states_;
+    std::vector<T*> idle_;
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include "latency_histogram.hpp"
+#include "per_thread.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ Named-scope profiler.
+
+   void decode() {
+       PROFILE_SCOPE("decode");
+       ...
+   }
+
+ Each thread accumulates its own call tree: a scope opened inside another
+ scope becomes its child, so "decode" called from "frame" and from "packet"
+ are reported separately as "frame/decode" and "packet/decode". Every node
+ keeps call count, total/min/max time and a log-linear latency histogram.
+ Updates are plain relaxed stores by the owning thread; report() merges the
+ trees of all threads on demand. A finished thread's tree keeps its counts and
+ is reused by the next new thread, so the number of trees is bounded by the
+ peak number of concurrent threads.
+*/
+namespace profiler {
+using clock = tsc_clock;
+
+namespace detail {
+    // Per-scope latency histogram: 8 linear sub-buckets per power of two (<= 12.5% error).
+    constexpr int kHistogramSubBits = 3;
+
+    struct node {
+        node(const char* name, node* parent) : name{name}, parent{parent} {}
+
+        // Only called by the owning thread; children are added under the thread's mutex.
+        node* child(const char* child_name, std::mutex& mutex) {
+            for (node* c : children) {
+                if (c->name == child_name) {
+                    return c;
+                }
+            }
+            for (node* c : children) {
+                if (std::strcmp(c->name, child_name) == 0) {
+                    return c;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            owned.push_back(std::make_unique<node>(child_name, this));
+            children.push_back(owned.back().get());
+            return children.back();
+        }
+
+        void record(std::uint64_t ns) {
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            total.store(total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+            if (ns < min.load(std::memory_order_relaxed)) {
+                min.store(ns, std::memory_order_relaxed);
+            }
+            if (ns > max.load(std::memory_order_relaxed)) {
+                max.store(ns, std::memory_order_relaxed);
+            }
+            hist.record_exclusive(ns);
+        }
+
+        void reset() {
+            count.store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            min.store(UINT64_MAX, std::memory_order_relaxed);
+            max.store(0, std::memory_order_relaxed);
+            hist.reset();
+            for (node* c : children) {
+                c->reset();
+            }
+        }
+
+        const char* const name;
+        node* const parent;
+        std::vector<node*> children;
+        std::vector<std::unique_ptr<node>> owned;
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> total{0};
+        std::atomic<std::uint64_t> min{UINT64_MAX};
+        std::atomic<std::uint64_t> max{0};
+        hdr_histogram hist{kHistogramSubBits};
+    };
+
+    struct thread_profile {
+        thread_profile() : root{"", nullptr}, current{&root} {}
+
+        std::mutex mutex; // guards the shape of the tree against report()
+        node root;
+        node* current;
+    };
+
+    struct registry {
+        per_thread<thread_profile> threads;
+        std::atomic<bool> enabled{true};
+    };
+
+    // Never destroyed: threads may still leave scopes during static destruction.
+    inline registry& global() {
+        static registry* r = new registry();
+        return *r;
+    }
+
+    inline thread_profile& local() {
+        return global().threads.local([] { return std::make_unique<thread_profile>(); },
+                                      [](thread_profile& p) { p.current = &p.root; });
+    }
+
+    struct aggregate {
+        std::uint64_t count{0};
+        std::uint64_t total{0};
+        std::uint64_t children_total{0};
+        std::uint64_t min{UINT64_MAX};
+        std::uint64_t max{0};
+        hdr_histogram hist{kHistogramSubBits};
+    };
+
+    inline void collect(const node& n, const std::string& path, std::map<std::string, aggregate>& out) {
+        for (const node* c : n.children) {
+            const std::string child_path = path.empty() ? std::string{c->name} : path + "/" + c->name;
+            aggregate& a = out[child_path];
+            const std::uint64_t total = c->total.load(std::memory_order_relaxed);
+            a.count += c->count.load(std::memory_order_relaxed);
+            a.total += total;
+            a.min = std::min(a.min, c->min.load(std::memory_order_relaxed));
+            a.max = std::max(a.max, c->max.load(std::memory_order_relaxed));
+            a.hist.merge(c->hist);
+            if (!path.empty()) {
+                out[path].children_total += total;
+            }
+            collect(*c, child_path, out);
+        }
+    }
+} // namespace detail
+
+/*!
+ RAII scope timer; prefer the PROFILE_SCOPE macro. name must outlive the
+ profiler, e.g. a string literal.
+*/
+class profile_scope {
+public:
+    explicit profile_scope(const char* name) {
+        if (!detail::global().enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        profile_ = &detail::local();
+        node_ = profile_->current->child(name, profile_->mutex);
+        profile_->current = node_;
+        start_ = clock::now();
+    }
+
+    ~profile_scope() {
+        if (node_ == nullptr) {
+            return;
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start_).count();
+        node_->record(static_cast<std::uint64_t>(ns));
+        profile_->current = node_->parent;
+    }
+
+    profile_scope(const profile_scope&) = delete;
+    profile_scope& operator=(const profile_scope&) = delete;
+
+private:
+    detail::thread_profile* profile_{nullptr};
+    detail::node* node_{nullptr};
+    clock::time_point start_;
+};
+
+inline void set_enabled(bool on) {
+    detail::global().enabled.store(on, std::memory_order_relaxed);
+}
+
+/*!
+ Clears the statistics of every thread. Updates racing with reset() on
+ another thread may survive it.
+*/
+inline void reset() {
+    detail::global().threads.for_each([](detail::thread_profile& t) {
+        std::lock_guard<std::mutex> tree_lock(t.mutex);
+        t.root.reset();
+    });
+}
+
+/*!
+ Returns a table of the top_n scopes by total time, merged over all threads.
+ Times are in microseconds; "self" excludes time spent in child scopes.
+ Call it on demand or from a periodic task.
+*/
+inline std::string report(size_t top_n = 20) {
+    std::map<std::string, detail::aggregate> merged;
+    detail::global().threads.for_each([&](detail::thread_profile& t) {
+        std::lock_guard<std::mutex> tree_lock(t.mutex);
+        detail::collect(t.root, std::string{}, merged);
+    });
+
+    std::vector<std::pair<const std::string*, const detail::aggregate*>> rows;
+    for (const auto& item : merged) {
+        if (item.second.count > 0) {
+            rows.emplace_back(&item.first, &item.second);
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second->total > b.second->total; });
+    if (rows.size() > top_n) {
+        rows.resize(top_n);
+    }
+
+    std::string out;
+    char line[512];
+    std::snprintf(line, sizeof(line), "%12s %12s %12s %10s %10s %10s %10s %10s  %s\n", "calls", "total(us)", "self(us)",
+        "avg(us)", "min(us)", "p50(us)", "p99(us)", "max(us)", "scope");
+    out.append(line);
+    for (const auto& [path, a] : rows) {
+        const std::uint64_t self = a->total > a->children_total ? a->total - a->children_total : 0;
+        std::snprintf(line, sizeof(line), "%12llu %12.1f %12.1f %10.3f %10.3f %10.3f %10.3f %10.3f  %s\n",
+            static_cast<unsigned long long>(a->count), a->total / 1e3, self / 1e3,
+            static_cast<double>(a->total) / static_cast<double>(a->count) / 1e3, a->min / 1e3,
+            a->hist.p50() / 1e3, a->hist.p99() / 1e3,
+            a->max / 1e3, path->c_str());
+        out.append(line);
+    }
+    return out;
+}
+} // namespace profiler
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef BASEUTILS_DISABLE_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ::profiler::profile_scope PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Slice is a non-owning view of a byte range: a pointer and a length.
+// The user must ensure that the data outlives the Slice.
+class Slice {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    Slice() : data_(""), size_(0) {}
+
+    Slice(const char* d, size_t n) : data_(d), size_(n) {}
+
+    Slice(const std::string& s) : data_(s.data()), size_(s.size()) {}
+
+    Slice(std::string_view s) : data_(s.data()), size_(s.size()) {}
+
+    Slice(const char* s) : data_(s), size_(strlen(s)) {}
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const char* begin() const {
+        return data_;
+    }
+
+    const char* end() const {
+        return data_ + size_;
+    }
+
+    char operator[](size_t n) const {
+        assert(n < size_);
+        return data_[n];
+    }
+
+    void clear() {
+        data_ = "";
+        size_ = 0;
+    }
+
+    void remove_prefix(size_t n) {
+        assert(n <= size_);
+        data_ += n;
+        size_ -= n;
+    }
+
+    void remove_suffix(size_t n) {
+        assert(n <= size_);
+        size_ -= n;
+    }
+
+    // Sub-view of at most n bytes starting at pos.
+    Slice sub(size_t pos, size_t n = npos) const {
+        assert(pos <= size_);
+        return Slice(data_ + pos, n < size_ - pos ? n : size_ - pos);
+    }
+
+    bool starts_with(const Slice& x) const {
+        return size_ >= x.size_ && memcmp(data_, x.data_, x.size_) == 0;
+    }
+
+    // <0 if *this < b, 0 if equal, >0 if *this > b
+    int compare(const Slice& b) const {
+        const size_t min_len = size_ < b.size_ ? size_ : b.size_;
+        int r = min_len == 0 ? 0 : memcmp(data_, b.data_, min_len);
+        if (r == 0) {
+            if (size_ < b.size_) {
+                r = -1;
+            } else if (size_ > b.size_) {
+                r = +1;
+            }
+        }
+        return r;
+    }
+
+    std::string ToString() const {
+        return std::string(data_, size_);
+    }
+
+    std::string_view to_string_view() const {
+        return std::string_view(data_, size_);
+    }
+
+    operator std::string_view() const {
+        return to_string_view();
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+inline bool operator==(const Slice& x, const Slice& y) {
+    return x.size() == y.size() && (x.size() == 0 || memcmp(x.data(), y.data(), x.size()) == 0);
+}
+
+inline bool operator!=(const Slice& x, const Slice& y) {
+    return !(x == y);
+}
+
+inline bool operator<(const Slice& x, const Slice& y) {
+    return x.compare(y) < 0;
+}
+
+namespace detail {
+    // Header of a reference-counted allocation; destroy frees it when the last reference goes.
+    struct shared_block {
+        std::atomic<size_t> refs{1};
+        void (*destroy)(shared_block*) noexcept {nullptr};
+
+        void retain() {
+            refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release() {
+            if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                destroy(this);
+            }
+        }
+
+        bool unique() const {
+            return refs.load(std::memory_order_acquire) == 1;
+        }
+    };
+} // namespace detail
+
+// SharedSlice is a Slice that keeps its underlying allocation alive.
+// Copies and sub-slices share the allocation; it is freed with the last of them.
+class SharedSlice {
+public:
+    SharedSlice() = default;
+
+    // Adopts one reference to block, which must contain [d, d + n).
+    SharedSlice(detail::shared_block* block, const char* d, size_t n) : block_(block), slice_(d, n) {}
+
+    SharedSlice(const SharedSlice& rhs) : block_(rhs.block_), slice_(rhs.slice_) {
+        if (block_ != nullptr) {
+            block_->retain();
+        }
+    }
+
+    SharedSlice(SharedSlice&& rhs) noexcept : block_(rhs.block_), slice_(rhs.slice_) {
+        rhs.block_ = nullptr;
+        rhs.slice_.clear();
+    }
+
+    SharedSlice& operator=(SharedSlice rhs) noexcept {
+        std::swap(block_, rhs.block_);
+        std::swap(slice_, rhs.slice_);
+        return *this;
+    }
+
+    ~SharedSlice() {
+        if (block_ != nullptr) {
+            block_->release();
+        }
+    }
+
+    const char* data() const {
+        return slice_.data();
+    }
+
+    size_t size() const {
+        return slice_.size();
+    }
+
+    bool empty() const {
+        return slice_.empty();
+    }
+
+    const Slice& slice() const {
+        return slice_;
+    }
+
+    // Sub-view sharing the same allocation, without copying.
+    SharedSlice sub(size_t pos, size_t n = Slice::npos) const {
+        SharedSlice result(*this);
+        result.slice_ = slice_.sub(pos, n);
+        return result;
+    }
+
+    std::string ToString() const {
+        return slice_.ToString();
+    }
+
+    std::string_view to_string_view() const {
+        return slice_.to_string_view();
+    }
+
+private:
+    detail::shared_block* block_{nullptr};
+    Slice slice_;
+};
@@ -4,70 +4,240 @@
 
 #ifndef THREAD_TRACE_HPP
 #define THREAD_TRACE_HPP
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
 #include <mutex>
-#include "circular_queue.hpp"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
 #include "date_time.hpp"
+#include "per_thread.hpp"
+#include "tsc_clock.hpp"
 
-namespace thread_id_helper {
-    namespace detail {
-        template<typename T, auto... field>
-        struct ThiefMember {
-            friend auto steal_impl(const T &t) {
-                return std::make_tuple(field...);
-            }
-        };
-
-        auto steal_impl(const std::thread::id &);
-
-        template struct ThiefMember<std::thread::id, &std::thread::id::_Id>;
-
-        static const auto member_tp = detail::steal_impl(std::thread::id{});
-    }
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
+namespace thread_id_helper {
     inline uint32_t to_number(const std::thread::id &tid) {
-        return tid.*(std::get<0>(detail::member_tp));
+        return static_cast<uint32_t>(std::hash<std::thread::id>{}(tid));
     }
 
+    /* 操作系统线程ID（Linux 为 gettid，Windows 为 GetCurrentThreadId），每个线程只查询一次 */
     inline uint32_t tid() {
-        return to_number(std::this_thread::get_id());
+        thread_local const uint32_t id = [] {
+#if defined(_WIN32)
+            return static_cast<uint32_t>(::GetCurrentThreadId());
+#elif defined(__linux__)
+            return static_cast<uint32_t>(::syscall(SYS_gettid));
+#else
+            return to_number(std::this_thread::get_id());
+#endif
+        }();
+        return id;
     }
 }
 
 
-class thread_trace {
+/* 一条跟踪记录，time_ns 为相对于跟踪开始时刻的纳秒数 */
+struct trace_event {
+    int64_t time_ns;
+    uint32_t tid;
+    uint16_t func;
+    bool enter;
+};
+
+/* thread_trace::capture() 生成的二进制跟踪数据的解析结果 */
+struct trace_capture {
+    int64_t wall_base_ns{};                 // 跟踪开始时刻的 UNIX 时间（纳秒）
+    std::map<uint16_t, std::string> names;  // 函数 ID -> 函数名
+    std::vector<trace_event> events;        // 按时间排序
+};
+
+/* 函数进入/离开跟踪。
+ *
+ * 每个线程写入自己的环形缓冲区（容量为 count，向上取整为 2 的幂），写入路径无锁且无等待，
+ * 只有线程第一次写入时需要加锁注册缓冲区。时间戳默认取自 tsc_clock（不支持时退回 steady_clock），
+ * 也可以换成其他时钟，例如 basic_thread_trace<coarse_steady_clock> 以 tick 精度换取更低的开销。
+ * dump() 时合并所有线程的记录并按时间排序。
+ * 缓冲区写满后覆盖该线程最旧的记录，因此可以作为常开的飞行记录器使用。
+ *
+ * 运行时可切换的记录模式（均可组合）：
+ *  - set_enabled(false)：关闭，trace_func_guard 的开销只有一次 relaxed 读取和一个分支；
+ *  - set_function_filter() + enable_function()：按函数 ID 位图过滤；
+ *  - set_sample_rate(n)：每个函数 ID 每 n 次记录 1 次；
+ *  - set_min_duration(d)：只记录时长不小于 d 的区间；
+ *  - set_trigger(d, callback)：区间时长超过 d 时回调，用于在延迟超标时导出完整跟踪。
+ */
+template <typename Clock = tsc_clock>
+class basic_thread_trace {
 public:
-    explicit thread_trace(size_t count = 512) : elements_{count} {
+    using clock = Clock;
+    using trigger_callback = std::function<void(uint16_t fun, std::chrono::nanoseconds duration)>;
+
+    /* begin() 返回的跟踪区间，交给 end() 结束 */
+    struct span {
+        int64_t start;
+        uint16_t fun;
+        uint8_t state;
+    };
+
+    explicit basic_thread_trace(size_t count = 512)
+        : capacity_{round_up_pow2(count)}, wall_base_{std::chrono::system_clock::now()},
+          steady_base_{clock::now()}, func_bits_{new std::atomic<uint64_t>[kFuncWords]} {
+        for (size_t i = 0; i < kFuncWords; ++i) {
+            func_bits_[i].store(~uint64_t{0}, std::memory_order_relaxed);
+        }
     }
 
+    basic_thread_trace(const basic_thread_trace &) = delete;
+    basic_thread_trace &operator=(const basic_thread_trace &) = delete;
+
+    /* 直接记录进入/离开。只受开关和函数过滤影响，采样与时长阈值需要通过 begin()/end() 或 trace_func_guard。 */
     void enter(uint16_t fun) {
-        const uint32_t tid = thread_id_helper::tid();
-        const uint64_t val = 1ull << 63 | static_cast<uint64_t>(fun) << 32 | tid;
-        std::lock_guard lock(mutex_);
-        elements_.push({val, date_time::now().to_since_epoch<std::chrono::milliseconds>()});
+        if (!accept(flags_.load(std::memory_order_relaxed), fun)) {
+            return;
+        }
+        const uint64_t val = 1ull << 63 | static_cast<uint64_t>(fun) << 32;
+        local_ring().push(val, clock::now().time_since_epoch().count());
     }
 
     void leave(uint16_t fun) {
-        const uint32_t tid = thread_id_helper::tid();
-        const uint64_t val = static_cast<uint64_t>(fun) << 32 | tid;
-        std::lock_guard lock(mutex_);
-        elements_.push({val, date_time::now().to_since_epoch<std::chrono::milliseconds>()});
+        if (!accept(flags_.load(std::memory_order_relaxed), fun)) {
+            return;
+        }
+        const uint64_t val = static_cast<uint64_t>(fun) << 32;
+        local_ring().push(val, clock::now().time_since_epoch().count());
     }
 
-    std::string dump() const {
-        mutex_.lock();
-        const size_t count = elements_.size();
-        std::vector<std::pair<uint64_t, int64_t>> datas(count);
-        for (size_t i = 0; i < count; ++i) {
-            datas[i] = elements_.at(i);
+    /* 开始一个跟踪区间，依次应用开关、函数过滤、采样和时长阈值。关闭时只有一次 relaxed 读取和一个分支。 */
+    span begin(uint16_t fun) {
+        const uint32_t flags = flags_.load(std::memory_order_relaxed);
+        if (!(flags & kEnabled)) {
+            return {0, fun, kInactive};
+        }
+        const int64_t now = clock::now().time_since_epoch().count();
+        const bool timing = flags & kTrigger;
+        if (!accept(flags, fun)) {
+            return {now, fun, timing ? kTimingOnly : kInactive};
+        }
+        if (flags & kSample) {
+            ring &r = local_ring();
+            const uint32_t every = sample_every_.load(std::memory_order_relaxed);
+            if (r.sample_counters[fun]++ % every != 0) {
+                return {now, fun, timing ? kTimingOnly : kInactive};
+            }
+        }
+        if (flags & kMinDuration) {
+            return {now, fun, kDeferred};
+        }
+        local_ring().push(1ull << 63 | static_cast<uint64_t>(fun) << 32, now);
+        return {now, fun, kRecorded};
+    }
+
+    void end(const span &s) {
+        if (s.state == kInactive) {
+            return;
         }
-        mutex_.unlock();
+        const int64_t now = clock::now().time_since_epoch().count();
+        const int64_t duration = now - s.start;
+        const uint64_t val = static_cast<uint64_t>(s.fun) << 32;
+        if (s.state == kRecorded) {
+            local_ring().push(val, now);
+        } else if (s.state == kDeferred && duration >= min_duration_.load(std::memory_order_relaxed)) {
+            ring &r = local_ring();
+            r.push(1ull << 63 | val, s.start);
+            r.push(val, now);
+        }
+        if (flags_.load(std::memory_order_relaxed) & kTrigger &&
+            duration >= trigger_threshold_.load(std::memory_order_relaxed)) {
+            fire_trigger(s.fun, duration);
+        }
+    }
+
+    /* 总开关，关闭后 enter()/leave()/begin() 不再记录 */
+    void set_enabled(bool on) {
+        set_flag(kEnabled, on);
+    }
+
+    bool enabled() const {
+        return flags_.load(std::memory_order_relaxed) & kEnabled;
+    }
+
+    /* 每个函数 ID 每 every_n 次调用记录 1 次（按线程计数），1 表示全部记录 */
+    void set_sample_rate(uint32_t every_n) {
+        sample_every_.store(std::max<uint32_t>(every_n, 1), std::memory_order_relaxed);
+        set_flag(kSample, every_n > 1);
+    }
+
+    /* 只记录时长不小于 duration 的区间，0 表示全部记录。启用后进入记录延迟到区间结束时写入。 */
+    void set_min_duration(std::chrono::nanoseconds duration) {
+        min_duration_.store(std::chrono::duration_cast<typename clock::duration>(duration).count(), std::memory_order_relaxed);
+        set_flag(kMinDuration, duration.count() > 0);
+    }
+
+    /* 函数过滤：启用后只记录 enable_function() 打开的函数 */
+    void set_function_filter(bool on) {
+        set_flag(kFilter, on);
+    }
+
+    void enable_function(uint16_t fun, bool on) {
+        const uint64_t bit = uint64_t{1} << (fun & 63);
+        if (on) {
+            func_bits_[fun >> 6].fetch_or(bit, std::memory_order_relaxed);
+        } else {
+            func_bits_[fun >> 6].fetch_and(~bit, std::memory_order_relaxed);
+        }
+    }
+
+    void enable_all_functions(bool on) {
+        for (size_t i = 0; i < kFuncWords; ++i) {
+            func_bits_[i].store(on ? ~uint64_t{0} : 0, std::memory_order_relaxed);
+        }
+    }
+
+    /* 区间时长超过 threshold 时，在当前线程调用 callback，例如在其中调用 capture() 保存现场。
+     * 触发检测对所有区间生效，包括被采样或过滤掉的区间。callback 为空时关闭。
+     */
+    void set_trigger(std::chrono::nanoseconds threshold, trigger_callback callback) {
+        const bool on = static_cast<bool>(callback);
+        {
+            std::lock_guard lock(mutex_);
+            trigger_ = std::move(callback);
+        }
+        trigger_threshold_.store(std::chrono::duration_cast<typename clock::duration>(threshold).count(),
+                                 std::memory_order_relaxed);
+        set_flag(kTrigger, on);
+    }
+
+    std::string dump() const {
+        std::vector<std::pair<uint64_t, int64_t>> datas = collect();
 
         std::stringstream ss;
         ss << "time, function, enter, tid\n";
         for (const auto &[fst, snd]: datas) {
             const auto tp = unpack(fst);
-            ss << date_time::from_since_epoch(snd).to_string("yyyy-MM-dd HH:mm:ss.zzz ");
+            ss << date_time::from_since_epoch(to_wall_ms(snd)).to_string("yyyy-MM-dd HH:mm:ss.zzz ");
             ss << std::left << std::setw(6) << std::get<1>(tp);
             ss << std::left << std::setw(2) << std::get<0>(tp);
             ss << std::left << std::get<2>(tp) << "\n";
@@ -75,7 +245,366 @@ public:
         return ss.str();
     }
 
+    /* 为函数 ID 设置名称，用于 capture() 和 Chrome Trace 导出 */
+    void set_name(uint16_t fun, std::string name) {
+        std::lock_guard lock(mutex_);
+        names_[fun] = std::move(name);
+    }
+
+    /* 将函数名映射为函数 ID，同名函数返回同一 ID。新 ID 从未使用过的最小值中分配。 */
+    uint16_t intern(std::string_view name) {
+        std::lock_guard lock(mutex_);
+        for (const auto &[id, n]: names_) {
+            if (n == name) {
+                return id;
+            }
+        }
+        uint16_t id = 0;
+        for (const auto &item: names_) {
+            if (item.first != id) {
+                break;
+            }
+            if (id == UINT16_MAX) {
+                throw std::length_error("thread_trace: function id space exhausted");
+            }
+            ++id;
+        }
+        names_.emplace(id, std::string{name});
+        return id;
+    }
+
+    /* 导出二进制跟踪数据（纳秒精度）。所有整数按小端序存储：
+     *
+     *   "TTRC"  u16 版本  u16 保留  i64 开始时刻的 UNIX 纳秒
+     *   u32 名称数量，之后每项：u16 函数ID  u16 长度  名称字节
+     *   u64 记录数量，之后每项：i64 相对纳秒  u32 线程ID  u16 函数ID  u8 进入标志  u8 保留
+     */
+    std::string capture() const {
+        const std::vector<std::pair<uint64_t, int64_t>> datas = collect();
+        std::map<uint16_t, std::string> names;
+        {
+            std::lock_guard lock(mutex_);
+            names = names_;
+        }
+
+        std::string out;
+        out.reserve(24 + names.size() * 24 + datas.size() * 16);
+        out.append(kCaptureMagic, 4);
+        put_le(out, kCaptureVersion, 2);
+        put_le(out, 0, 2);
+        put_le(out, static_cast<uint64_t>(wall_base_ns()), 8);
+        put_le(out, names.size(), 4);
+        for (const auto &[id, name]: names) {
+            const size_t len = std::min<size_t>(name.size(), UINT16_MAX);
+            put_le(out, id, 2);
+            put_le(out, len, 2);
+            out.append(name.data(), len);
+        }
+        put_le(out, datas.size(), 8);
+        for (const auto &[fst, snd]: datas) {
+            const auto [flag, fun, tid] = unpack(fst);
+            put_le(out, static_cast<uint64_t>(to_relative_ns(snd)), 8);
+            put_le(out, tid, 4);
+            put_le(out, fun, 2);
+            put_le(out, flag ? 1 : 0, 1);
+            put_le(out, 0, 1);
+        }
+        return out;
+    }
+
+    /* 解析 capture() 生成的数据，格式错误时抛出 std::runtime_error */
+    static trace_capture parse_capture(std::string_view data) {
+        size_t pos = 0;
+        const auto get = [&](size_t bytes) {
+            if (data.size() - pos < bytes) {
+                throw std::runtime_error("thread_trace: truncated capture");
+            }
+            uint64_t val = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                val |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+            }
+            pos += bytes;
+            return val;
+        };
+
+        if (data.substr(0, 4) != std::string_view{kCaptureMagic, 4}) {
+            throw std::runtime_error("thread_trace: bad capture magic");
+        }
+        pos = 4;
+        if (get(2) != kCaptureVersion) {
+            throw std::runtime_error("thread_trace: unsupported capture version");
+        }
+        get(2);
+
+        trace_capture result;
+        result.wall_base_ns = static_cast<int64_t>(get(8));
+        for (uint64_t n = get(4); n > 0; --n) {
+            const auto id = static_cast<uint16_t>(get(2));
+            const auto len = static_cast<size_t>(get(2));
+            if (data.size() - pos < len) {
+                throw std::runtime_error("thread_trace: truncated capture");
+            }
+            result.names[id] = std::string{data.substr(pos, len)};
+            pos += len;
+        }
+        const uint64_t count = get(8);
+        if ((data.size() - pos) / 16 < count) {
+            throw std::runtime_error("thread_trace: truncated capture");
+        }
+        result.events.reserve(count);
+        for (uint64_t n = 0; n < count; ++n) {
+            trace_event e{};
+            e.time_ns = static_cast<int64_t>(get(8));
+            e.tid = static_cast<uint32_t>(get(4));
+            e.func = static_cast<uint16_t>(get(2));
+            e.enter = get(1) != 0;
+            get(1);
+            result.events.push_back(e);
+        }
+        return result;
+    }
+
+    /* 转换为 Chrome Trace Event JSON，可直接用 chrome://tracing 或 Perfetto UI (ui.perfetto.dev) 打开。
+     * 进入/离开分别对应 "B"/"E" 事件，时间单位为微秒（保留纳秒小数），每个线程一条泳道。
+     */
+    static std::string to_chrome_json(const trace_capture &capture) {
+        std::string out;
+        out.reserve(64 + capture.events.size() * 80);
+        out.append("{\"displayTimeUnit\":\"ns\",\"otherData\":{\"wall_base_ns\":");
+        out.append(std::to_string(capture.wall_base_ns));
+        out.append("},\"traceEvents\":[");
+
+        char buf[64];
+        bool first = true;
+        for (const trace_event &e: capture.events) {
+            out.append(first ? "\n" : ",\n");
+            first = false;
+            out.append("{\"name\":\"");
+            if (const auto it = capture.names.find(e.func); it != capture.names.end()) {
+                append_json_escaped(out, it->second);
+            } else {
+                out.append(std::to_string(e.func));
+            }
+            std::snprintf(buf, sizeof(buf), "\",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":1,\"tid\":%u}",
+                          e.enter ? 'B' : 'E', static_cast<long long>(e.time_ns / 1000),
+                          static_cast<long long>(e.time_ns % 1000), e.tid);
+            out.append(buf);
+        }
+        out.append("\n]}\n");
+        return out;
+    }
+
+    std::string dump_chrome_json() const {
+        return to_chrome_json(parse_capture(capture()));
+    }
+
 private:
+    static constexpr char kCaptureMagic[] = "TTRC";
+    static constexpr uint64_t kCaptureVersion = 1;
+
+    static void put_le(std::string &out, uint64_t val, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) {
+            out.push_back(static_cast<char>(val >> (8 * i) & 0xFF));
+        }
+    }
+
+    static void append_json_escaped(std::string &out, std::string_view str) {
+        for (const char c: str) {
+            switch (c) {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                        out.append(buf);
+                    } else {
+                        out.push_back(c);
+                    }
+                    break;
+            }
+        }
+    }
+
+    int64_t wall_base_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(wall_base_.time_since_epoch()).count();
+    }
+
+    int64_t to_relative_ns(int64_t steady_time) const {
+        const auto since_base = typename clock::duration{steady_time} - steady_base_.time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(since_base).count();
+    }
+
+    /* 单个线程的环形缓冲区。只有所属线程写入，dump() 可以并发读取。
+     * 每个槽位带序号（seqlock）：写入期间为 kBusy，写完后为位置 + 1，读取时序号前后不一致的槽位被丢弃。 */
+    struct ring {
+        struct slot {
+            std::atomic<uint64_t> seq{0};
+            std::atomic<uint64_t> val{0};
+            std::atomic<int64_t> time{0};
+        };
+
+        static constexpr uint64_t kBusy = UINT64_MAX;
+
+        /* 按完整函数 ID 计数的开放寻址表（线性探测），不同函数互不影响。装载率超过一半时扩容，仅所属线程访问。 */
+        class sample_table {
+        public:
+            uint32_t &operator[](uint16_t fun) {
+                if ((size_ + 1) * 2 > entries_.size()) {
+                    grow();
+                }
+                entry &e = probe(entries_, fun);
+                if (e.key == 0) {
+                    e.key = fun + 1u;
+                    ++size_;
+                }
+                return e.count;
+            }
+
+            void clear() {
+                std::fill(entries_.begin(), entries_.end(), entry{});
+                size_ = 0;
+            }
+
+        private:
+            struct entry {
+                uint32_t key{0}; // 函数 ID + 1，0 表示空位
+                uint32_t count{0};
+            };
+
+            static entry &probe(std::vector<entry> &entries, uint16_t fun) {
+                const size_t mask = entries.size() - 1;
+                size_t i = (fun * 2654435761u) & mask;
+                while (entries[i].key != 0 && entries[i].key != fun + 1u) {
+                    i = (i + 1) & mask;
+                }
+                return entries[i];
+            }
+
+            void grow() {
+                std::vector<entry> bigger(entries_.size() * 2);
+                for (const entry &e: entries_) {
+                    if (e.key != 0) {
+                        probe(bigger, static_cast<uint16_t>(e.key - 1)) = e;
+                    }
+                }
+                entries_.swap(bigger);
+            }
+
+            std::vector<entry> entries_ = std::vector<entry>(64);
+            size_t size_{0};
+        };
+
+        ring(size_t capacity, uint32_t tid) : slots{new slot[capacity]}, mask{capacity - 1}, tid{tid} {}
+
+        void push(uint64_t val, int64_t time) {
+            const uint64_t h = head.load(std::memory_order_relaxed);
+            slot &s = slots[h & mask];
+            s.seq.store(kBusy, std::memory_order_relaxed);
+            // 保证读取方看到新数据时，也一定能看到 kBusy
+            std::atomic_thread_fence(std::memory_order_release);
+            s.val.store(val | tid, std::memory_order_relaxed);
+            s.time.store(time, std::memory_order_relaxed);
+            s.seq.store(h + 1, std::memory_order_release);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // 复制当前有效的记录；正在写入或已被覆盖的槽位会被丢弃
+        void snapshot(std::vector<std::pair<uint64_t, int64_t>> &out) const {
+            const uint64_t capacity = mask + 1;
+            const uint64_t end = head.load(std::memory_order_acquire);
+            const uint64_t begin = end > capacity ? end - capacity : 0;
+            for (uint64_t i = begin; i < end; ++i) {
+                const slot &s = slots[i & mask];
+                const uint64_t seq = s.seq.load(std::memory_order_acquire);
+                const uint64_t val = s.val.load(std::memory_order_relaxed);
+                const int64_t time = s.time.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq == i + 1 && s.seq.load(std::memory_order_relaxed) == seq) {
+                    out.emplace_back(val, time);
+                }
+            }
+        }
+
+        std::unique_ptr<slot[]> slots;
+        const uint64_t mask;
+        uint32_t tid; // 线程退出后缓冲区留给下一个新线程复用，已写入的记录各自带有原线程 ID
+        std::atomic<uint64_t> head{0};
+        sample_table sample_counters; // 采样计数
+    };
+
+    enum : uint32_t {
+        kEnabled = 1u << 0,
+        kFilter = 1u << 1,
+        kSample = 1u << 2,
+        kMinDuration = 1u << 3,
+        kTrigger = 1u << 4,
+    };
+
+    enum : uint8_t { kInactive, kRecorded, kDeferred, kTimingOnly };
+
+    static constexpr size_t kFuncWords = 65536 / 64;
+
+    bool accept(uint32_t flags, uint16_t fun) const {
+        if (!(flags & kEnabled)) {
+            return false;
+        }
+        return !(flags & kFilter) || func_bits_[fun >> 6].load(std::memory_order_relaxed) >> (fun & 63) & 1;
+    }
+
+    void set_flag(uint32_t flag, bool on) {
+        if (on) {
+            flags_.fetch_or(flag, std::memory_order_relaxed);
+        } else {
+            flags_.fetch_and(~flag, std::memory_order_relaxed);
+        }
+    }
+
+    void fire_trigger(uint16_t fun, int64_t duration) {
+        trigger_callback callback;
+        {
+            std::lock_guard lock(mutex_);
+            callback = trigger_;
+        }
+        if (callback) {
+            callback(fun, std::chrono::duration_cast<std::chrono::nanoseconds>(typename clock::duration{duration}));
+        }
+    }
+
+    static size_t round_up_pow2(size_t count) {
+        size_t capacity = 1;
+        while (capacity < count) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // 当前线程在本对象中的缓冲区；复用已退出线程的缓冲区时改为当前线程 ID 并清零采样计数
+    ring &local_ring() {
+        return rings_.local([this] { return std::make_unique<ring>(capacity_, thread_id_helper::tid()); },
+                            [](ring &r) {
+                                r.tid = thread_id_helper::tid();
+                                r.sample_counters.clear();
+                            });
+    }
+
+    std::vector<std::pair<uint64_t, int64_t>> collect() const {
+        std::vector<std::pair<uint64_t, int64_t>> datas;
+        datas.reserve(rings_.size() * capacity_);
+        rings_.for_each([&](const ring &r) { r.snapshot(datas); });
+        std::stable_sort(datas.begin(), datas.end(),
+                         [](const auto &a, const auto &b) { return a.second < b.second; });
+        return datas;
+    }
+
+    int64_t to_wall_ms(int64_t steady_time) const {
+        const auto since_base = typename clock::duration{steady_time} - steady_base_.time_since_epoch();
+        const auto wall = wall_base_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(since_base);
+        return std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count();
+    }
+
     /* 从低位到高位：
      *  0~31位：线程ID
      * 32~47位：函数
@@ -90,24 +619,40 @@ private:
         return {flag, fun, tid};
     }
 
+    const size_t capacity_;
+    const std::chrono::system_clock::time_point wall_base_;
+    const typename clock::time_point steady_base_;
     mutable std::mutex mutex_;
-    circular_queue<std::pair<uint64_t, int64_t>> elements_;
+    per_thread<ring> rings_;
+    std::map<uint16_t, std::string> names_;
+    trigger_callback trigger_;
+
+    std::atomic<uint32_t> flags_{kEnabled};
+    std::atomic<uint32_t> sample_every_{1};
+    std::atomic<int64_t> min_duration_{0};
+    std::atomic<int64_t> trigger_threshold_{0};
+    const std::unique_ptr<std::atomic<uint64_t>[]> func_bits_;
 };
 
+using thread_trace = basic_thread_trace<>;
 
+
+template <typename Clock = tsc_clock>
 class trace_func_guard {
 public:
-    trace_func_guard(thread_trace &trace, uint16_t func): trace_{trace}, func_{func} {
-        trace_.enter(func_);
+    trace_func_guard(basic_thread_trace<Clock> &trace, uint16_t func): trace_{trace}, span_{trace.begin(func)} {
     }
 
     ~trace_func_guard() {
-        trace_.leave(func_);
+        trace_.end(span_);
     }
 
+    trace_func_guard(const trace_func_guard &) = delete;
+    trace_func_guard &operator=(const trace_func_guard &) = delete;
+
 private:
-    thread_trace &trace_;
-    const uint16_t func_;
+    basic_thread_trace<Clock> &trace_;
+    const typename basic_thread_trace<Clock>::span span_;
 };
 
 #endif //THREAD_TRACE_HPP
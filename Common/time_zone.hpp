@@ -0,0 +1,563 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+namespace detail {
+/*!
+ Proleptic Gregorian date of a day count since 1970-01-01 and back
+ (H. Hinnant's civil_from_days / days_from_civil).
+*/
+constexpr void civil_from_days(std::int64_t z, std::int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const std::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const auto doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<std::int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+constexpr std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const auto yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+constexpr bool is_leap_year(std::int64_t y) {
+    return y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+}
+} // namespace detail
+
+/*!
+ A time zone as a table of UTC offsets.
+
+ Zones are read once from the TZif files of the system tz database
+ ($TZDIR or /usr/share/zoneinfo) or built from a POSIX TZ string such as
+ "CST-8" or "EST5EDT,M3.2.0,M11.1.0". Rules past the last recorded
+ transition are expanded into the table up to kLastRuleYear, so offset()
+ is a bounds check against the previous lookup and, when that misses, a
+ binary search; it never calls into libc, takes no lock and does no I/O.
+
+ Zones returned by locate()/current() are never freed, so the pointers can be
+ kept and shared freely between threads.
+
+   const time_zone* ny = time_zone::locate("America/New_York");
+   date_time::now().to_string("yyyy-MM-dd HH:mm:ss", ny);
+*/
+class time_zone {
+public:
+    static constexpr std::int64_t kLastRuleYear = 2100;
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    // UTC offset, in seconds, in effect at utc_seconds since epoch.
+    std::int32_t offset(std::int64_t utc_seconds) const {
+        const size_t n = times_.size();
+        if (n == 0 || utc_seconds < times_[0]) {
+            return initial_offset_;
+        }
+        size_t i = hint_.load(std::memory_order_relaxed);
+        if (i < n && times_[i] <= utc_seconds && (i + 1 == n || utc_seconds < times_[i + 1])) {
+            return offsets_[i];
+        }
+        i = static_cast<size_t>(std::upper_bound(times_.begin(), times_.end(), utc_seconds) - times_.begin()) - 1;
+        hint_.store(i, std::memory_order_relaxed);
+        return offsets_[i];
+    }
+
+    std::chrono::seconds offset(std::chrono::system_clock::time_point tp) const {
+        return std::chrono::seconds{
+            offset(std::chrono::floor<std::chrono::seconds>(tp.time_since_epoch()).count())};
+    }
+
+    /*!
+     UTC time of a local wall-clock time. Ambiguous times (clocks set back)
+     resolve to the earlier instant, skipped times (clocks set forward) are
+     shifted by the size of the gap.
+    */
+    std::int64_t to_utc(std::int64_t local_seconds) const {
+        const std::int64_t guess = local_seconds - offset(local_seconds);
+        return local_seconds - offset(guess);
+    }
+
+    /*!
+     Zone by tz database name ("Europe/Berlin", "UTC"), or by POSIX TZ string.
+     The first lookup of a name loads it; later ones are a map lookup.
+     @throw std::runtime_error if the name is neither
+    */
+    static const time_zone* locate(std::string_view name) {
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        const auto it = r.zones.find(name);
+        if (it != r.zones.end()) {
+            return it->second.get();
+        }
+        auto zone = load(name);
+        const time_zone* result = zone.get();
+        r.zones.emplace(std::string{name}, std::move(zone));
+        return result;
+    }
+
+    static const time_zone* utc() {
+        static const time_zone* zone = locate("UTC");
+        return zone;
+    }
+
+    /*!
+     Process-wide zone used for time_spec::local. Initialised on first use from
+     $TZ, then /etc/localtime, falling back to UTC.
+    */
+    static const time_zone* current() {
+        const time_zone* zone = current_zone().load(std::memory_order_acquire);
+        if (zone == nullptr) {
+            static const time_zone* detected = detect_local();
+            const time_zone* expected = nullptr;
+            current_zone().compare_exchange_strong(expected, detected, std::memory_order_acq_rel);
+            zone = current_zone().load(std::memory_order_acquire);
+        }
+        return zone;
+    }
+
+    static void set_current(const time_zone* zone) {
+        current_zone().store(zone != nullptr ? zone : utc(), std::memory_order_release);
+    }
+
+private:
+    time_zone() = default;
+
+    struct rule {
+        char form{'M'}; // 'M' month.week.day, 'J' julian day 1..365 without Feb 29, 'n' zero-based day 0..365
+        int month{0}, week{0}, day{0};
+        std::int32_t time{7200}; // local seconds after midnight
+    };
+
+    struct posix_tz {
+        std::int32_t std_offset{0};
+        std::int32_t dst_offset{0};
+        bool has_dst{false};
+        rule start, end;
+    };
+
+    struct registry {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<time_zone>, std::less<>> zones;
+    };
+
+    static registry& get_registry() {
+        static registry r;
+        return r;
+    }
+
+    static std::atomic<const time_zone*>& current_zone() {
+        static std::atomic<const time_zone*> zone{nullptr};
+        return zone;
+    }
+
+    static const time_zone* detect_local() {
+        const char* tz = std::getenv("TZ");
+        if (tz != nullptr && *tz != '\0') {
+            std::string_view name{tz};
+            if (name.front() == ':') {
+                name.remove_prefix(1);
+            }
+            try {
+                return locate(name);
+            } catch (const std::exception&) {
+            }
+        }
+#if defined(_WIN32)
+        const std::string system_tz = windows_posix_tz();
+        if (!system_tz.empty()) {
+            try {
+                return locate(system_tz);
+            } catch (const std::exception&) {
+            }
+        }
+        // The fixed UTC+8 that date_time used before zones were supported.
+        return locate("<+08>-8");
+#else
+        try {
+            return locate("/etc/localtime");
+        } catch (const std::exception&) {
+        }
+        return utc();
+#endif
+    }
+
+#if defined(_WIN32)
+    // The system time zone's current rules as a POSIX TZ string; empty if unavailable.
+    static std::string windows_posix_tz() {
+        DYNAMIC_TIME_ZONE_INFORMATION info{};
+        if (GetDynamicTimeZoneInformation(&info) == TIME_ZONE_ID_INVALID) {
+            return {};
+        }
+        // Windows biases are minutes west of UTC, the same sign as POSIX offsets.
+        auto offset = [](long minutes) {
+            std::string out = minutes < 0 ? "-" : "";
+            minutes = minutes < 0 ? -minutes : minutes;
+            out += std::to_string(minutes / 60);
+            if (minutes % 60 != 0) {
+                out += ':' + std::to_string(minutes % 60);
+            }
+            return out;
+        };
+        // wDay is the week of the month, 5 meaning the last one, as in POSIX Mm.w.d.
+        auto rule = [](const SYSTEMTIME& t) {
+            return ",M" + std::to_string(t.wMonth) + "." + std::to_string(t.wDay) + "." + std::to_string(t.wDayOfWeek) +
+                   "/" + std::to_string(t.wHour) + ":" + std::to_string(t.wMinute);
+        };
+        std::string tz = "<STD>" + offset(info.Bias + info.StandardBias);
+        // A non-zero wYear is a one-off absolute date; such zones are taken as fixed.
+        if (info.DaylightDate.wMonth != 0 && info.StandardDate.wMonth != 0 && info.DaylightDate.wYear == 0) {
+            tz += "<DST>" + offset(info.Bias + info.DaylightBias) + rule(info.DaylightDate) + rule(info.StandardDate);
+        }
+        return tz;
+    }
+#endif
+
+    static std::unique_ptr<time_zone> load(std::string_view name) {
+        std::unique_ptr<time_zone> zone{new time_zone};
+        zone->name_ = std::string{name};
+        if (name == "UTC" || name == "Etc/UTC" || name == "GMT") {
+            return zone;
+        }
+
+        std::string path{name};
+        if (path.empty() || path.front() != '/') {
+            const char* dir = std::getenv("TZDIR");
+            path = std::string{dir != nullptr ? dir : "/usr/share/zoneinfo"} + "/" + path;
+        }
+        std::ifstream file{path, std::ios::binary};
+        if (file && name.find("..") == std::string_view::npos) {
+            const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+            zone->parse_tzif(data);
+            return zone;
+        }
+
+        posix_tz tz;
+        if (!parse_posix(name, tz)) {
+            throw std::runtime_error("time_zone: unknown time zone " + std::string{name});
+        }
+        zone->initial_offset_ = tz.std_offset;
+        zone->extend(tz, 1970);
+        return zone;
+    }
+
+    // RFC 8536. Leap second records are skipped: offsets are against POSIX time.
+    void parse_tzif(std::string_view data) {
+        size_t pos = 0;
+        auto need = [&](size_t n) {
+            if (pos + n > data.size()) {
+                throw std::runtime_error("time_zone: truncated TZif data in " + name_);
+            }
+        };
+        auto be = [&](size_t bytes) {
+            need(bytes);
+            std::uint64_t v = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                v = (v << 8) | static_cast<unsigned char>(data[pos++]);
+            }
+            return v;
+        };
+        auto be_signed = [&](size_t bytes) {
+            const std::uint64_t v = be(bytes);
+            return bytes == 4 ? static_cast<std::int64_t>(static_cast<std::int32_t>(v)) : static_cast<std::int64_t>(v);
+        };
+
+        struct header {
+            char version;
+            std::uint64_t isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+        };
+        auto read_header = [&]() {
+            need(44);
+            if (data.substr(pos, 4) != "TZif") {
+                throw std::runtime_error("time_zone: not a TZif file: " + name_);
+            }
+            header h{};
+            h.version = data[pos + 4];
+            pos += 20;
+            h.isutcnt = be(4);
+            h.isstdcnt = be(4);
+            h.leapcnt = be(4);
+            h.timecnt = be(4);
+            h.typecnt = be(4);
+            h.charcnt = be(4);
+            return h;
+        };
+        auto block_size = [](const header& h, size_t time_size) {
+            return h.timecnt * time_size + h.timecnt + h.typecnt * 6 + h.charcnt + h.leapcnt * (time_size + 4) +
+                   h.isstdcnt + h.isutcnt;
+        };
+
+        header h = read_header();
+        size_t time_size = 4;
+        if (h.version >= '2') {
+            // Skip the 32-bit block; the 64-bit one that follows is complete.
+            need(block_size(h, 4));
+            pos += block_size(h, 4);
+            h = read_header();
+            time_size = 8;
+        }
+
+        std::vector<std::int64_t> times(h.timecnt);
+        std::vector<std::uint8_t> type_index(h.timecnt);
+        std::vector<std::int32_t> type_offset(h.typecnt);
+        for (auto& t : times) {
+            t = be_signed(time_size);
+        }
+        for (auto& i : type_index) {
+            i = static_cast<std::uint8_t>(be(1));
+        }
+        for (auto& o : type_offset) {
+            o = static_cast<std::int32_t>(be(4));
+            pos += 2; // isdst, desigidx
+        }
+        pos += h.charcnt + h.leapcnt * (time_size + 4) + h.isstdcnt + h.isutcnt;
+        need(0);
+        if (h.typecnt == 0) {
+            throw std::runtime_error("time_zone: no local time types in " + name_);
+        }
+
+        initial_offset_ = type_offset[0];
+        for (size_t i = 0; i < times.size(); ++i) {
+            if (type_index[i] >= type_offset.size()) {
+                throw std::runtime_error("time_zone: bad time type index in " + name_);
+            }
+            push(times[i], type_offset[type_index[i]]);
+        }
+
+        // The footer (v2+) is a POSIX TZ string for times after the last transition.
+        if (time_size == 8 && pos < data.size() && data[pos] == '\n') {
+            const size_t end = data.find('\n', pos + 1);
+            posix_tz tz;
+            if (end != std::string_view::npos && parse_posix(data.substr(pos + 1, end - pos - 1), tz)) {
+                std::int64_t from_year = 1970;
+                if (!times_.empty()) {
+                    std::int64_t y;
+                    unsigned m, d;
+                    detail::civil_from_days(floor_div(times_.back(), 86400), y, m, d);
+                    from_year = y;
+                }
+                if (times_.empty()) {
+                    initial_offset_ = tz.std_offset;
+                }
+                extend(tz, from_year);
+            }
+        }
+    }
+
+    void push(std::int64_t t, std::int32_t off) {
+        if (!times_.empty() && t <= times_.back()) {
+            return;
+        }
+        if (offsets_.empty() ? off == initial_offset_ : off == offsets_.back()) {
+            return;
+        }
+        times_.push_back(t);
+        offsets_.push_back(off);
+    }
+
+    // Appends the transitions of a POSIX rule for from_year..kLastRuleYear.
+    void extend(const posix_tz& tz, std::int64_t from_year) {
+        if (!tz.has_dst) {
+            push(times_.empty() ? INT64_MIN : times_.back() + 1, tz.std_offset);
+            return;
+        }
+        for (std::int64_t y = from_year; y <= kLastRuleYear; ++y) {
+            const std::int64_t start = rule_local_seconds(tz.start, y) - tz.std_offset;
+            const std::int64_t end = rule_local_seconds(tz.end, y) - tz.dst_offset;
+            if (start < end) {
+                push(start, tz.dst_offset);
+                push(end, tz.std_offset);
+            } else {
+                // Southern hemisphere: DST spans the new year.
+                push(end, tz.std_offset);
+                push(start, tz.dst_offset);
+            }
+        }
+    }
+
+    static std::int64_t rule_local_seconds(const rule& r, std::int64_t year) {
+        std::int64_t days;
+        if (r.form == 'J') {
+            days = detail::days_from_civil(year, 1, 1) + r.day - 1;
+            if (detail::is_leap_year(year) && r.day >= 60) {
+                ++days;
+            }
+        } else if (r.form == 'n') {
+            days = detail::days_from_civil(year, 1, 1) + r.day;
+        } else {
+            const std::int64_t first = detail::days_from_civil(year, static_cast<unsigned>(r.month), 1);
+            const std::int64_t first_weekday = floor_mod(first + 4, 7); // 1970-01-01 was a Thursday
+            days = first + floor_mod(r.day - first_weekday, 7) + (r.week - 1) * 7;
+            if (r.week == 5) {
+                static constexpr unsigned kMonthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+                const unsigned month_days =
+                    kMonthDays[r.month - 1] + (r.month == 2 && detail::is_leap_year(year) ? 1 : 0);
+                while (days >= first + month_days) {
+                    days -= 7;
+                }
+            }
+        }
+        return days * 86400 + r.time;
+    }
+
+    // POSIX.1-2017 TZ grammar with the RFC 8536 extensions (hours up to 167, negative times).
+    static bool parse_posix(std::string_view s, posix_tz& tz) {
+        size_t pos = 0;
+        auto parse_name = [&]() {
+            if (pos < s.size() && s[pos] == '<') {
+                const size_t end = s.find('>', pos);
+                if (end == std::string_view::npos) {
+                    return false;
+                }
+                pos = end + 1;
+                return true;
+            }
+            const size_t begin = pos;
+            while (pos < s.size() && ((s[pos] >= 'A' && s[pos] <= 'Z') || (s[pos] >= 'a' && s[pos] <= 'z'))) {
+                ++pos;
+            }
+            return pos - begin >= 3;
+        };
+        auto parse_number = [&](int& v) {
+            if (pos >= s.size() || s[pos] < '0' || s[pos] > '9') {
+                return false;
+            }
+            v = 0;
+            while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9') {
+                v = v * 10 + (s[pos++] - '0');
+            }
+            return true;
+        };
+        auto parse_time = [&](std::int32_t& seconds) {
+            int sign = 1;
+            if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')) {
+                sign = s[pos++] == '-' ? -1 : 1;
+            }
+            int h = 0, m = 0, sec = 0;
+            if (!parse_number(h)) {
+                return false;
+            }
+            if (pos < s.size() && s[pos] == ':') {
+                ++pos;
+                if (!parse_number(m)) {
+                    return false;
+                }
+                if (pos < s.size() && s[pos] == ':') {
+                    ++pos;
+                    if (!parse_number(sec)) {
+                        return false;
+                    }
+                }
+            }
+            seconds = sign * (h * 3600 + m * 60 + sec);
+            return true;
+        };
+        auto parse_rule = [&](rule& r) {
+            if (pos >= s.size() || s[pos++] != ',') {
+                return false;
+            }
+            if (pos < s.size() && s[pos] == 'M') {
+                ++pos;
+                r.form = 'M';
+                if (!parse_number(r.month) || pos >= s.size() || s[pos++] != '.' || !parse_number(r.week) ||
+                    pos >= s.size() || s[pos++] != '.' || !parse_number(r.day)) {
+                    return false;
+                }
+                if (r.month < 1 || r.month > 12 || r.week < 1 || r.week > 5 || r.day > 6) {
+                    return false;
+                }
+            } else {
+                r.form = 'n';
+                if (pos < s.size() && s[pos] == 'J') {
+                    ++pos;
+                    r.form = 'J';
+                }
+                if (!parse_number(r.day)) {
+                    return false;
+                }
+            }
+            r.time = 7200;
+            if (pos < s.size() && s[pos] == '/') {
+                ++pos;
+                return parse_time(r.time);
+            }
+            return true;
+        };
+
+        std::int32_t std_west = 0;
+        if (!parse_name() || !parse_time(std_west)) {
+            return false;
+        }
+        // POSIX offsets count hours west of Greenwich.
+        tz.std_offset = -std_west;
+        tz.dst_offset = tz.std_offset;
+        tz.has_dst = false;
+        if (pos == s.size()) {
+            return true;
+        }
+        if (!parse_name()) {
+            return false;
+        }
+        tz.has_dst = true;
+        tz.dst_offset = tz.std_offset + 3600;
+        if (pos < s.size() && s[pos] != ',') {
+            std::int32_t dst_west = 0;
+            if (!parse_time(dst_west)) {
+                return false;
+            }
+            tz.dst_offset = -dst_west;
+        }
+        if (pos == s.size()) {
+            // No rules given: the POSIX default is the US rule.
+            tz.start = rule{'M', 3, 2, 0, 7200};
+            tz.end = rule{'M', 11, 1, 0, 7200};
+            return true;
+        }
+        return parse_rule(tz.start) && parse_rule(tz.end) && pos == s.size();
+    }
+
+    static std::int64_t floor_div(std::int64_t a, std::int64_t b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+
+    static std::int64_t floor_mod(std::int64_t a, std::int64_t b) {
+        return a - floor_div(a, b) * b;
+    }
+
+    std::string name_;
+    std::int32_t initial_offset_{0};
+    std::vector<std::int64_t> times_;   // UTC seconds of each transition, ascending
+    std::vector<std::int32_t> offsets_; // offset in effect from times_[i]
+    mutable std::atomic<size_t> hint_{0};
+};
@@ -1,31 +1,36 @@
 #pragma once
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <string>
 
-template <typename unit = std::milli>
+/*!
+ @tparam unit   period of the values returned by restart()/elapsed()
+ @tparam clock  any steady Clock, e.g. std::chrono::steady_clock or tsc_clock
+*/
+template <typename unit = std::milli, typename clock = std::chrono::high_resolution_clock>
 class elapsed_timer {
 public:
-    elapsed_timer() : start_{std::chrono::high_resolution_clock::now()} {}
+    elapsed_timer() : start_{clock::now()} {}
 
     double restart() {
-        const auto end{std::chrono::high_resolution_clock::now()};
+        const auto end{clock::now()};
         const auto value{std::chrono::duration<double, unit>(end - start_).count()};
         start_ = end;
         return value;
     }
 
     double elapsed() {
-        const auto end{std::chrono::high_resolution_clock::now()};
+        const auto end{clock::now()};
         const auto value{std::chrono::duration<double, unit>(end - start_).count()};
         return value;
     }
 
 private:
-    std::chrono::high_resolution_clock::time_point start_;
+    typename clock::time_point start_;
 };
 
-template <typename unit = std::milli>
+template <typename unit = std::milli, typename clock = std::chrono::high_resolution_clock>
 class scoped_timer {
 public:
     scoped_timer() : t_{} {}
@@ -35,5 +40,5 @@ public:
     const scoped_timer& operator=(const scoped_timer&) = delete;
 
 private:
-    elapsed_timer<unit> t_;
+    elapsed_timer<unit, clock> t_;
 };
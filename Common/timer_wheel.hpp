@@ -0,0 +1,348 @@
+#pragma once
+#include "SequentialThreadPool.hpp"
+#include "ThreadPool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*!
+ Hierarchical timer wheel driven by a single thread.
+
+ Four levels of 256/64/64/64 slots cover 2^26 ticks (about 18.6 hours at the
+ default 1 ms tick); longer delays are parked in the last slot and re-filed
+ when it cascades. Timers live in a slab of intrusive list nodes, so schedule
+ and cancel are O(1) and hundreds of thousands of pending timers cost only
+ memory. The driver thread sleeps until the next non-empty slot.
+
+ Expired callbacks are handed to an executor: inline on the wheel thread by
+ default, or posted to a ThreadPool or to a SequentialThreadPool group. Keep
+ inline callbacks short, they delay every other timer.
+
+   timer_wheel wheel{pool};
+   auto id = wheel.schedule_after(std::chrono::seconds{1}, [] { on_timeout(); });
+   wheel.cancel(id);
+*/
+class timer_wheel {
+public:
+    using clock = std::chrono::steady_clock;
+    using callback = std::function<void()>;
+    // Receives the group passed to schedule_*() and the callback to run.
+    using executor = std::function<void(uint32_t, callback)>;
+
+    struct timer_id {
+        uint32_t index{UINT32_MAX};
+        uint32_t generation{0};
+
+        explicit operator bool() const {
+            return index != UINT32_MAX;
+        }
+    };
+
+    explicit timer_wheel(std::chrono::milliseconds tick = std::chrono::milliseconds{1}, executor exec = {})
+        : tick_{tick}, exec_{std::move(exec)}, origin_{clock::now()} {
+        for (auto& head : slots_) {
+            head = kNil;
+        }
+        driver_ = std::thread([this] { run(); });
+    }
+
+    explicit timer_wheel(ThreadPool& pool, std::chrono::milliseconds tick = std::chrono::milliseconds{1})
+        : timer_wheel(tick, [&pool](uint32_t, callback cb) { pool.enqueue(std::move(cb)); }) {}
+
+    // Callbacks of the same group run in order on the pool.
+    explicit timer_wheel(SequentialThreadPool& pool, std::chrono::milliseconds tick = std::chrono::milliseconds{1})
+        : timer_wheel(tick, [&pool](uint32_t group, callback cb) { pool.post(group, std::move(cb)); }) {}
+
+    // Pending timers are dropped; callbacks already handed to the executor still run.
+    ~timer_wheel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_one();
+        driver_.join();
+    }
+
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel& operator=(const timer_wheel&) = delete;
+
+    template <typename Rep, typename Period>
+    timer_id schedule_after(std::chrono::duration<Rep, Period> delay, callback cb, uint32_t group = 0) {
+        return add(delay, 0, std::move(cb), group);
+    }
+
+    /*!
+     Runs cb every period, first after first_delay (default: one period).
+     Rearming keeps the original phase, so the schedule does not drift.
+    */
+    template <typename Rep, typename Period>
+    timer_id schedule_every(std::chrono::duration<Rep, Period> period, callback cb, uint32_t group = 0) {
+        return schedule_every(period, period, std::move(cb), group);
+    }
+
+    template <typename Rep, typename Period, typename Rep2, typename Period2>
+    timer_id schedule_every(std::chrono::duration<Rep, Period> period, std::chrono::duration<Rep2, Period2> first_delay,
+        callback cb, uint32_t group = 0) {
+        return add(first_delay, std::max<uint64_t>(to_ticks(period), 1), std::move(cb), group);
+    }
+
+    /*!
+     @return true if the timer was pending and will not fire again; false if it
+     already fired (one-shot), was cancelled, or its callback is being dispatched.
+    */
+    bool cancel(timer_id id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id.index >= nodes_.size() || nodes_[id.index].generation != id.generation || !nodes_[id.index].armed) {
+            return false;
+        }
+        unlink(id.index);
+        release(id.index);
+        return true;
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_;
+    }
+
+private:
+    static constexpr int kRootBits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr int kLevels = 4;
+    static constexpr uint32_t kRootSize = 1u << kRootBits;
+    static constexpr uint32_t kLevelSize = 1u << kLevelBits;
+    static constexpr uint64_t kMaxDelta = (uint64_t{1} << (kRootBits + (kLevels - 1) * kLevelBits)) - 1;
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct node {
+        uint64_t expires{0};
+        uint64_t period{0}; // ticks, 0 for one-shot
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint32_t slot{kNil};
+        uint32_t generation{0};
+        uint32_t group{0};
+        bool armed{false};
+        callback cb;
+    };
+
+    template <typename Rep, typename Period>
+    uint64_t to_ticks(std::chrono::duration<Rep, Period> d) const {
+        const auto ticks = (std::chrono::duration_cast<clock::duration>(d) + tick_ - clock::duration{1}) / tick_;
+        return ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+    }
+
+    uint64_t current_tick() const {
+        return static_cast<uint64_t>((clock::now() - origin_) / tick_);
+    }
+
+    template <typename Rep, typename Period>
+    timer_id add(std::chrono::duration<Rep, Period> delay, uint64_t period, callback cb, uint32_t group) {
+        // Rounded up from the exact time, so a timer never fires before its delay has elapsed.
+        const uint64_t expires = to_ticks(std::chrono::duration_cast<clock::duration>(delay) + (clock::now() - origin_));
+        bool wake{};
+        timer_id id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_ == 0) {
+                // Nothing is filed, so the wheel can jump straight to the present.
+                next_tick_ = std::max(next_tick_, current_tick());
+            }
+            const uint32_t index = acquire();
+            node& n = nodes_[index];
+            n.expires = expires;
+            n.period = period;
+            n.group = group;
+            n.cb = std::move(cb);
+            link(index);
+            wake = n.expires < wake_tick_;
+            id = {index, n.generation};
+        }
+        if (wake) {
+            condition_.notify_one();
+        }
+        return id;
+    }
+
+    uint32_t acquire() {
+        uint32_t index;
+        if (free_ != kNil) {
+            index = free_;
+            free_ = nodes_[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+        nodes_[index].armed = true;
+        ++pending_;
+        return index;
+    }
+
+    void release(uint32_t index) {
+        node& n = nodes_[index];
+        n.armed = false;
+        n.cb = nullptr;
+        ++n.generation;
+        n.next = free_;
+        free_ = index;
+        --pending_;
+    }
+
+    uint32_t slot_for(uint64_t expires) const {
+        if (expires < next_tick_) {
+            return static_cast<uint32_t>(next_tick_ & (kRootSize - 1));
+        }
+        uint64_t delta = expires - next_tick_;
+        if (delta > kMaxDelta) {
+            delta = kMaxDelta;
+            expires = next_tick_ + kMaxDelta;
+        }
+        if (delta < kRootSize) {
+            return static_cast<uint32_t>(expires & (kRootSize - 1));
+        }
+        for (int level = 1; level < kLevels; ++level) {
+            const int shift = kRootBits + level * kLevelBits;
+            if (level == kLevels - 1 || delta < (uint64_t{1} << shift)) {
+                const int low = shift - kLevelBits;
+                return kRootSize + (level - 1) * kLevelSize + static_cast<uint32_t>((expires >> low) & (kLevelSize - 1));
+            }
+        }
+        return kNil;
+    }
+
+    void link(uint32_t index) {
+        node& n = nodes_[index];
+        n.slot = slot_for(n.expires);
+        n.prev = kNil;
+        n.next = slots_[n.slot];
+        if (n.next != kNil) {
+            nodes_[n.next].prev = index;
+        }
+        slots_[n.slot] = index;
+    }
+
+    void unlink(uint32_t index) {
+        node& n = nodes_[index];
+        if (n.prev != kNil) {
+            nodes_[n.prev].next = n.next;
+        } else {
+            slots_[n.slot] = n.next;
+        }
+        if (n.next != kNil) {
+            nodes_[n.next].prev = n.prev;
+        }
+        n.prev = n.next = n.slot = kNil;
+    }
+
+    // Re-files every timer of a higher-level slot; returns the slot index within its level.
+    uint32_t cascade(int level) {
+        const int low = kRootBits + (level - 1) * kLevelBits;
+        const auto index = static_cast<uint32_t>((next_tick_ >> low) & (kLevelSize - 1));
+        const uint32_t slot = kRootSize + (level - 1) * kLevelSize + index;
+        uint32_t i = slots_[slot];
+        slots_[slot] = kNil;
+        while (i != kNil) {
+            const uint32_t next = nodes_[i].next;
+            link(i);
+            i = next;
+        }
+        return index;
+    }
+
+    // Advances the wheel up to now and collects the expired callbacks.
+    void expire(uint64_t now, std::vector<std::pair<uint32_t, callback>>& fired) {
+        while (next_tick_ <= now && pending_ > 0) {
+            const auto index = static_cast<uint32_t>(next_tick_ & (kRootSize - 1));
+            if (index == 0) {
+                for (int level = 1; level < kLevels && cascade(level) == 0; ++level) {}
+            }
+            uint32_t i = slots_[index];
+            slots_[index] = kNil;
+            while (i != kNil) {
+                node& n = nodes_[i];
+                const uint32_t next = n.next;
+                n.prev = n.next = n.slot = kNil;
+                if (n.expires > next_tick_) {
+                    // Clamped timer that is still further out than the wheel span.
+                    link(i);
+                } else if (n.period != 0) {
+                    fired.emplace_back(n.group, n.cb);
+                    // A late timer must not go back into the slot being drained, which would
+                    // delay it by a whole revolution.
+                    n.expires = std::max(n.expires + n.period, next_tick_ + 1);
+                    link(i);
+                } else {
+                    fired.emplace_back(n.group, std::move(n.cb));
+                    release(i);
+                }
+                i = next;
+            }
+            ++next_tick_;
+        }
+        if (pending_ == 0) {
+            next_tick_ = std::max(next_tick_, now + 1);
+        }
+    }
+
+    // First tick worth waking up for: the next non-empty root slot, or the next cascade.
+    uint64_t next_wake() const {
+        if (pending_ == 0) {
+            return UINT64_MAX;
+        }
+        for (uint64_t t = next_tick_; t < (next_tick_ | (kRootSize - 1)) + 1; ++t) {
+            if (slots_[t & (kRootSize - 1)] != kNil) {
+                return t;
+            }
+        }
+        return (next_tick_ | (kRootSize - 1)) + 1;
+    }
+
+    void run() {
+        std::vector<std::pair<uint32_t, callback>> fired;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            expire(current_tick(), fired);
+            if (!fired.empty()) {
+                lock.unlock();
+                for (auto& [group, cb] : fired) {
+                    if (exec_) {
+                        exec_(group, std::move(cb));
+                    } else {
+                        cb();
+                    }
+                }
+                fired.clear();
+                lock.lock();
+                continue;
+            }
+            wake_tick_ = next_wake();
+            if (wake_tick_ == UINT64_MAX) {
+                condition_.wait(lock);
+            } else {
+                condition_.wait_until(lock, origin_ + tick_ * static_cast<clock::rep>(wake_tick_));
+            }
+            wake_tick_ = 0;
+        }
+    }
+
+    const clock::duration tick_;
+    const executor exec_;
+    const clock::time_point origin_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<node> nodes_;
+    uint32_t free_{kNil};
+    size_t pending_{0};
+    uint32_t slots_[kRootSize + (kLevels - 1) * kLevelSize];
+    uint64_t next_tick_{0}; // first tick not processed yet
+    uint64_t wake_tick_{0}; // tick the driver sleeps until, 0 while it is awake
+    bool stop_{false};
+    std::thread driver_;
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TSC_CLOCK_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TSC_CLOCK_X86 1
+#endif
+
+/*!
+ Steady clock read from the CPU time-stamp counter.
+
+ On x86 with an invariant TSC (CPUID 8000_0007h EDX bit 8) now() is a single
+ rdtsc plus a fixed-point multiply, several times cheaper than a vDSO
+ clock_gettime. On AArch64 the architectural virtual counter is used. When no
+ usable counter exists the clock falls back to std::chrono::steady_clock.
+
+ The tick rate is calibrated against steady_clock once, on first use, over
+ calibration_window (about 10 ms). Call tsc_clock::now() once during start-up
+ to move that cost out of the measured path.
+
+ Meets the Clock requirements, so it can be used as elapsed_timer<unit,
+ tsc_clock>, scoped_timer<unit, tsc_clock> or basic_rate<tsc_clock>.
+*/
+class tsc_clock {
+public:
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<tsc_clock>;
+    static constexpr bool is_steady = true;
+
+    static constexpr std::chrono::milliseconds calibration_window{10};
+
+    static time_point now() noexcept {
+        const calibration& c = get_calibration();
+        if (!c.use_counter) {
+            return time_point{std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+        }
+        return time_point{duration{c.base_ns + to_ns(c, since_base(c, read_counter()))}};
+    }
+
+    /*!
+     Like now(), but waits for all preceding instructions to retire (rdtscp),
+     so the timed code cannot be reordered after the read.
+    */
+    static time_point now_ordered() noexcept {
+        const calibration& c = get_calibration();
+        if (!c.use_counter) {
+            return now();
+        }
+        return time_point{duration{c.base_ns + to_ns(c, since_base(c, read_counter_ordered()))}};
+    }
+
+    // Raw counter value; 0 when the counter is not used.
+    static std::uint64_t ticks() noexcept {
+        return get_calibration().use_counter ? read_counter() : 0;
+    }
+
+    static bool is_counter_based() noexcept {
+        return get_calibration().use_counter;
+    }
+
+    static double ticks_per_second() noexcept {
+        return get_calibration().ticks_per_second;
+    }
+
+private:
+    struct calibration {
+        bool use_counter{false};
+        double ticks_per_second{0};
+        std::uint64_t base_ticks{0};
+        std::int64_t base_ns{0};
+        std::uint64_t mult{0}; // ns = ticks * mult >> kShift
+    };
+
+    static constexpr int kShift = 32;
+
+    // Signed: a core whose counter lags the calibrating one can read below base_ticks.
+    static std::int64_t since_base(const calibration& c, std::uint64_t counter) noexcept {
+        return static_cast<std::int64_t>(counter - c.base_ticks);
+    }
+
+    static std::int64_t to_ns(const calibration& c, std::int64_t ticks) noexcept {
+#if defined(__SIZEOF_INT128__)
+        return static_cast<std::int64_t>((static_cast<__int128>(ticks) * c.mult) >> kShift);
+#else
+        return static_cast<std::int64_t>(static_cast<double>(ticks) * 1e9 / c.ticks_per_second);
+#endif
+    }
+
+    static bool counter_is_invariant() noexcept {
+#if defined(TSC_CLOCK_X86) && defined(_MSC_VER)
+        int regs[4]{};
+        __cpuid(regs, 0x80000000);
+        if (static_cast<unsigned>(regs[0]) < 0x80000007u) {
+            return false;
+        }
+        __cpuid(regs, 0x80000007);
+        return (regs[3] >> 8) & 1;
+#elif defined(TSC_CLOCK_X86)
+        unsigned eax{}, ebx{}, ecx{}, edx{};
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (edx >> 8) & 1;
+#elif defined(__aarch64__)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static std::uint64_t read_counter() noexcept {
+#if defined(TSC_CLOCK_X86)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        std::uint64_t v;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+        return v;
+#else
+        return 0;
+#endif
+    }
+
+    static std::uint64_t read_counter_ordered() noexcept {
+#if defined(TSC_CLOCK_X86)
+        unsigned aux;
+        return __rdtscp(&aux);
+#elif defined(__aarch64__)
+        std::uint64_t v;
+        asm volatile("isb; mrs %0, cntvct_el0" : "=r"(v)::"memory");
+        return v;
+#else
+        return 0;
+#endif
+    }
+
+    static calibration calibrate() noexcept {
+        calibration c;
+        if (!counter_is_invariant()) {
+            return c;
+        }
+        using steady = std::chrono::steady_clock;
+        const auto t0 = steady::now();
+        const std::uint64_t c0 = read_counter();
+        auto t1 = t0;
+        while (t1 - t0 < calibration_window) {
+            t1 = steady::now();
+        }
+        const std::uint64_t c1 = read_counter();
+        const double seconds = std::chrono::duration<double>(t1 - t0).count();
+        if (c1 <= c0 || seconds <= 0) {
+            return c;
+        }
+
+        c.use_counter = true;
+        c.ticks_per_second = static_cast<double>(c1 - c0) / seconds;
+        c.mult = static_cast<std::uint64_t>(1e9 / c.ticks_per_second * static_cast<double>(std::uint64_t{1} << kShift));
+        c.base_ticks = c1;
+        c.base_ns = std::chrono::duration_cast<duration>(t1.time_since_epoch()).count();
+        return c;
+    }
+
+    static const calibration& get_calibration() noexcept {
+        static const calibration c = calibrate();
+        return c;
+    }
+};